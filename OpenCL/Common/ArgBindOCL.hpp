@@ -0,0 +1,85 @@
+// ArgBindOCL.hpp - Typed kernel argument binding, setting only changed values.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// KernArgs<T...> maps a tuple of plain data values (scalars, cl vector types,
+// cl_mem handles) to consecutive kernel arguments. Types and sizes are checked
+// at compile time. The values last set on the kernel are retained, so bind()
+// calls clSetKernelArg only for arguments that differ (byte-wise), which cuts
+// host overhead for frequent small launches. The retained state is only valid
+// while nothing else sets arguments on the same kernel: see invalidate().
+
+#ifndef ARG_BIND_OCL_HPP
+#define ARG_BIND_OCL_HPP
+
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+
+#include <CL/cl.h>
+
+// Largest kernel argument accepted (e.g. double16)
+#define KERN_ARG_MAX_BYTES 128
+
+template <typename... U> struct KernArgsOK;
+template <> struct KernArgsOK<> { static const bool value= true; };
+template <typename U, typename... R> struct KernArgsOK<U,R...>
+{
+   static const bool value= std::is_trivially_copyable<U>::value && (sizeof(U) <= KERN_ARG_MAX_BYTES) && KernArgsOK<R...>::value;
+}; // KernArgsOK
+
+template <typename... T>
+class KernArgs
+{
+   static_assert(sizeof...(T) <= 32, "KernArgs: too many arguments");
+   static_assert(KernArgsOK<T...>::value, "KernArgs: arguments must be plain data of at most KERN_ARG_MAX_BYTES");
+
+protected:
+   std::tuple<T...>  last;    // values as set on kernel
+   cl_kernel   k;
+   cl_uint     i0;            // index of first argument
+   uint32_t    valid;         // mask of arguments set on kernel
+
+   template <size_t I> cl_int setOne (void)
+   {
+      const auto& v= std::get<I>(val);
+      auto& l= std::get<I>(last);
+      if ((valid & (1u << I)) && (0 == memcmp(&v, &l, sizeof(v)))) { skips++; return(0); } // unchanged
+      cl_int r= clSetKernelArg(k, i0 + I, sizeof(v), &v);
+      if (r >= 0) { l= v; valid|= 1u << I; sets++; }
+      return(r);
+   } // setOne
+
+   template <size_t... I> cl_int setAll (std::index_sequence<I...>)
+   {
+      cl_int r= 0;
+      int seq[]= { 0, (r|= setOne<I>(), 0)... };
+      (void)seq;
+      return(r);
+   } // setAll
+
+public:
+   std::tuple<T...>  val;     // values for next launch
+   size_t   sets, skips;      // clSetKernelArg calls made & avoided
+
+   KernArgs (void) : k{0}, i0{0}, valid{0}, sets{0}, skips{0} { ; }
+   KernArgs (const T&... v) : k{0}, i0{0}, valid{0}, val(v...), sets{0}, skips{0} { ; }
+
+   static constexpr size_t count (void) { return(sizeof...(T)); }
+
+   template <size_t I> typename std::tuple_element<I, std::tuple<T...>>::type& arg (void) { return std::get<I>(val); }
+
+   // Force all arguments to be set on next bind (kernel args changed elsewhere)
+   void invalidate (void) { valid= 0; }
+
+   // Set changed arguments on kernel, starting at argument index <first>
+   cl_int bind (cl_kernel kern, cl_uint first=0)
+   {
+      if ((kern != k) || (first != i0)) { k= kern; i0= first; valid= 0; }
+      return setAll(std::index_sequence_for<T...>{});
+   } // bind
+}; // KernArgs
+
+#endif // ARG_BIND_OCL_HPP
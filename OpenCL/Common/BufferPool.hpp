@@ -0,0 +1,203 @@
+// BufferPool.hpp - Size class pools of aligned host buffers and device buffers.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Released buffers are kept on free lists by power of two size class (minimum
+// 4kB) rather than freed, and handed out again for any request of the same
+// class: repeated jobs of varying size then stop paying allocation (and, on
+// the host, first touch page fault) costs. At most half of each buffer is
+// unused. Device buffers are also matched by context and memory flags; those
+// referring to host memory (USE/COPY/ALLOC_HOST_PTR) are never pooled.
+// Allocations bypassing the pool (disabled, or not poolable) are counted in the
+// same statistics, so pooled and unpooled runs compare directly.
+
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+#include <CL/cl.h>
+
+#define POOL_MIN_CLASS  12    // 4kB
+#define POOL_NUM_CLASS  40
+#define POOL_HOST_ALIGN 128   // >= typical CL_DEVICE_MEM_BASE_ADDR_ALIGN (bits / 8)
+
+struct PoolStats
+{
+   size_t allocs, reuses, frees;    // counts
+   size_t live, pooled, highWater;  // bytes (by size class)
+
+   PoolStats (void) : allocs{0}, reuses{0}, frees{0}, live{0}, pooled{0}, highWater{0} { ; }
+
+   void acquired (size_t b, bool reuse)
+   {
+      if (reuse) { reuses++; pooled-= b; } else { allocs++; }
+      live+= b;
+      if (live > highWater) { highWater= live; }
+   } // acquired
+
+   // Buffer given back: kept in pool, or freed
+   void released (size_t b, bool pool)
+   {
+      live-= std::min(live, b); // acquired before a reset
+      if (pool) { pooled+= b; } else { frees++; }
+   } // released
+
+   // Restart counts, byte levels (buffers still held) retained
+   void resetCounts (void) { allocs= reuses= frees= 0; highWater= live; }
+
+   float reuseRate (void) const { size_t n= allocs + reuses; return((n > 0) ? (float)reuses / n : 0); }
+}; // PoolStats
+
+int poolSizeClass (size_t bytes)
+{
+   int c= POOL_MIN_CLASS;
+   while ((((size_t)1) << c) < bytes) { c++; }
+   return(c);
+} // poolSizeClass
+
+class CHostPool
+{
+protected:
+   std::vector<void*> free[POOL_NUM_CLASS];
+
+public:
+   PoolStats   stats;
+   bool        enabled;
+
+   CHostPool (void) : enabled{true} { ; }
+   ~CHostPool () { trim(); }
+
+   void *acquire (size_t bytes)
+   {
+      const int c= poolSizeClass(bytes);
+      const size_t b= ((size_t)1) << c;
+      void *p= NULL;
+      if (c >= POOL_NUM_CLASS) { return(NULL); }
+      if (enabled && (free[c].size() > 0))
+      {
+         p= free[c].back();
+         free[c].pop_back();
+         stats.acquired(b, true);
+      }
+      else if (0 == posix_memalign(&p, POOL_HOST_ALIGN, b)) { stats.acquired(b, false); }
+      else { p= NULL; }
+      return(p);
+   } // acquire
+
+   // <bytes> as requested on acquire
+   void release (void *p, size_t bytes)
+   {
+      const int c= poolSizeClass(bytes);
+      const size_t b= ((size_t)1) << c;
+      if (NULL == p) { return; }
+      stats.released(b, enabled);
+      if (enabled) { free[c].push_back(p); }
+      else { ::free(p); }
+   } // release
+
+   void trim (void)
+   {
+      for (int c=0; c<POOL_NUM_CLASS; c++)
+      {
+         for (void *p : free[c]) { ::free(p); stats.frees++; }
+         free[c].clear();
+      }
+      stats.pooled= 0;
+   } // trim
+}; // CHostPool
+
+class CDevicePool
+{
+protected:
+   struct Entry
+   {
+      cl_context     ctx;
+      cl_mem_flags   f;
+      cl_mem         h;
+   }; // Entry
+   std::vector<Entry> free[POOL_NUM_CLASS];
+
+   static bool poolable (cl_mem_flags f) { return(0 == (f & (CL_MEM_USE_HOST_PTR|CL_MEM_COPY_HOST_PTR|CL_MEM_ALLOC_HOST_PTR))); }
+
+   // Buffer holds whole size class (not one allocated exactly while the pool was bypassed)
+   static bool fullClass (cl_mem h, size_t b)
+   {
+      size_t s= 0;
+      return((clGetMemObjectInfo(h, CL_MEM_SIZE, sizeof(s), &s, NULL) >= 0) && (s >= b));
+   } // fullClass
+
+public:
+   PoolStats   stats;
+   bool        enabled;
+
+   CDevicePool (void) : enabled{true} { ; }
+   ~CDevicePool () { trim(); }
+
+   cl_mem acquire (cl_context ctx, size_t bytes, cl_mem_flags f, cl_int *pR)
+   {
+      const int c= poolSizeClass(bytes);
+      const size_t b= ((size_t)1) << c;
+      if (!enabled || !poolable(f) || (c >= POOL_NUM_CLASS))
+      {
+         cl_mem h= clCreateBuffer(ctx, f, bytes, NULL, pR);
+         if (0 != h) { stats.acquired(b, false); }
+         return(h);
+      }
+      for (size_t i= free[c].size(); i-- > 0; )
+      {
+         Entry& e= free[c][i];
+         if ((e.ctx == ctx) && (e.f == f))
+         {
+            cl_mem h= e.h;
+            free[c].erase(free[c].begin() + i);
+            stats.acquired(b, true);
+            if (pR) { *pR= CL_SUCCESS; }
+            return(h);
+         }
+      }
+      cl_mem h= clCreateBuffer(ctx, f, b, NULL, pR);
+      if (0 != h) { stats.acquired(b, false); }
+      return(h);
+   } // acquire
+
+   // <bytes> & <f> as requested on acquire
+   cl_int release (cl_mem h, cl_context ctx, size_t bytes, cl_mem_flags f)
+   {
+      const int c= poolSizeClass(bytes);
+      const size_t b= ((size_t)1) << c;
+      if (0 == h) { return(CL_SUCCESS); }
+      const bool pool= enabled && poolable(f) && (c < POOL_NUM_CLASS) && fullClass(h, b);
+      stats.released(b, pool);
+      if (!pool) { return clReleaseMemObject(h); }
+      free[c].push_back(Entry{ctx, f, h});
+      return(CL_SUCCESS);
+   } // release
+
+   // Free pooled buffers (of given context, or all)
+   void trim (cl_context ctx=0)
+   {
+      for (int c=0; c<POOL_NUM_CLASS; c++)
+      {
+         for (size_t i= free[c].size(); i-- > 0; )
+         {
+            Entry& e= free[c][i];
+            if ((0 == ctx) || (e.ctx == ctx))
+            {
+               clReleaseMemObject(e.h);
+               stats.pooled-= ((size_t)1) << c;
+               stats.frees++;
+               free[c].erase(free[c].begin() + i);
+            }
+         }
+      }
+   } // trim
+}; // CDevicePool
+
+CHostPool gHostPool;
+CDevicePool gDevPool;
+
+#endif // BUFFER_POOL_HPP
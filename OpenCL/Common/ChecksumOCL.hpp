@@ -0,0 +1,283 @@
+// ChecksumOCL.hpp - Device side map checksums and golden result verification.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Each work group hashes one tile of the (device resident) map: every element
+// is mixed with its index (murmur3 finaliser) and the results summed in two
+// independently seeded 32bit lanes, so value, position and order changes all
+// show. A single group then combines tile hashes, again keyed by index, into
+// a root hash. Checking a frame reads back only the root (8 bytes); tile
+// hashes are read only to locate divergence. Golden results (root and tiles)
+// are kept per key (kernel, view, definition) and device (DeviceProfile name &
+// driver hash) in files <dir>/<key>-<device>.gold, dir given by OCL_GOLDEN or
+// "golden". They are recorded only when OCL_GOLDEN_RECORD=1, otherwise a
+// missing golden result fails the check.
+// Elements are keyed by row-major index whatever the map layout, so hashes
+// (and golden results) do not depend on layout.
+// The map buffer must be readable by kernels (e.g. CL_MEM_READ_WRITE), image
+// maps (CMapImageOCL::createImage()) are not supported.
+
+#ifndef CHECKSUM_OCL_HPP
+#define CHECKSUM_OCL_HPP
+
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+#include "MapImageOCL.hpp"
+
+#define CHK_LOCAL_MAX   1024  // tile elements (work group size)
+#define CHK_ROOT_WS     64    // root combining work group size
+#define CHK_GOLD_MAGIC  0x444C4F47 // "GOLD"
+
+
+/* OpenCL kernel source */
+
+const char checksumSrc[]=
+"#define CHK_LOCAL_MAX 1024\n" \
+"uint mix (uint h) { h^= h >> 16; h*= 0x85EBCA6Bu; h^= h >> 13; h*= 0xC2B2AE35u; h^= h >> 16; return(h); }\n" \
+"uint2 keyed (const uint v, const uint i) { return (uint2)(mix(v ^ mix(i)), mix(v + mix(i ^ 0x9E3779B9u))); }\n" \
+"\n" \
+"void reduce (__local uint2 *lH, const uint l, const uint nl)\n" \
+"{ for (uint s= nl >> 1; s > 0; s>>= 1) { barrier(CLK_LOCAL_MEM_FENCE); if (l < s) { lH[l]+= lH[l+s]; } } }\n" \
+"\n" \
+"kernel void tileHash (__global uint2 *pT, __global const int *pI, const ushort2 def)\n" \
+"{ __local uint2 lH[CHK_LOCAL_MAX];\n" \
+"  const uint x= get_global_id(0), y= get_global_id(1);\n" \
+"  const uint l= get_local_id(1) * get_local_size(0) + get_local_id(0), nl= get_local_size(0) * get_local_size(1);\n" \
+"  uint2 h= (uint2)(0,0);\n" \
+"  if ((x < def.x) && (y < def.y)) { h= keyed(pI[MAP_IDX(x,y,def)], y * def.x + x); }\n" \
+"  lH[l]= h;\n" \
+"  reduce(lH, l, nl);\n" \
+"  if (0 == l) { pT[get_group_id(1) * get_num_groups(0) + get_group_id(0)]= lH[0]; } }\n" \
+"\n" \
+"kernel void rootHash (__global uint2 *pT, const uint n)\n" \
+"{ __local uint2 lH[CHK_LOCAL_MAX];\n" \
+"  const uint l= get_local_id(0), nl= get_local_size(0);\n" \
+"  uint2 h= (uint2)(0,0);\n" \
+"  for (uint i= l; i < n; i+= nl) { const uint2 t= pT[i]; h+= keyed(t.x, i) + keyed(t.y, ~i); }\n" \
+"  lH[l]= h;\n" \
+"  reduce(lH, l, nl);\n" \
+"  if (0 == l) { pT[n]= lH[0]; } }\n"; // root follows tiles
+
+
+/***/
+
+struct MapHash
+{
+   cl_uint h[2];
+
+   bool operator== (const MapHash& a) const { return((h[0] == a.h[0]) && (h[1] == a.h[1])); }
+   bool operator!= (const MapHash& a) const { return(!(*this == a)); }
+}; // MapHash
+
+struct GoldenHeader
+{
+   uint32_t magic;
+   uint16_t def[2], tile[2];
+   uint32_t nT;
+   MapHash  root;
+}; // GoldenHeader
+
+class CMapChecksum
+{
+protected:
+   cl_program  idProg;
+   cl_kernel   kT, kR;
+   cl_mem      hT;
+   cl_uint     nT;
+   size_t      ng[2], rws;
+   std::vector<MapHash> tiles, gold;   // last read, golden
+   MapHash     goldRoot;
+   char        goldKey[96];
+
+   static cl_uint mix (cl_uint h) { h^= h >> 16; h*= 0x85EBCA6Bu; h^= h >> 13; h*= 0xC2B2AE35u; h^= h >> 16; return(h); }
+   static void keyed (MapHash& s, const cl_uint v, const cl_uint i) { s.h[0]+= mix(v ^ mix(i)); s.h[1]+= mix(v + mix(i ^ 0x9E3779B9u)); }
+
+   static void path (char s[], size_t max, const char key[])
+   {
+      const char *dir= getenv("OCL_GOLDEN");
+      if (NULL == dir) { dir= "golden"; }
+      snprintf(s, max, "%s/%s.gold", dir, key);
+   } // path
+
+   bool loadGolden (const char key[])
+   {
+      GoldenHeader g;
+      char s[256];
+      path(s, sizeof(s), key);
+      auto inFile= std::fstream(s, std::ios::in | std::ios::binary);
+      if (inFile.is_open() && inFile.read((char *)&g, sizeof(g)) && (CHK_GOLD_MAGIC == g.magic) &&
+         (g.def[0] == def.x) && (g.def[1] == def.y) && (g.tile[0] == tile[0]) && (g.tile[1] == tile[1]) && (g.nT == nT))
+      {
+         gold.resize(nT);
+         if (inFile.read((char *)gold.data(), nT * sizeof(MapHash)))
+         {
+            goldRoot= g.root;
+            snprintf(goldKey, sizeof(goldKey), "%s", key);
+            return(true);
+         }
+      }
+      gold.clear();
+      goldKey[0]= 0;
+      return(false);
+   } // loadGolden
+
+   bool saveGolden (const char key[], const MapHash& root)
+   {
+      GoldenHeader g={ CHK_GOLD_MAGIC, { def.x, def.y }, { (uint16_t)tile[0], (uint16_t)tile[1] }, nT, root };
+      char s[256];
+      const char *dir= getenv("OCL_GOLDEN");
+      mkdir(dir ? dir : "golden", 0755);
+      path(s, sizeof(s), key);
+      auto outFile= std::fstream(s, std::ios::out | std::ios::binary);
+      return(outFile.is_open() && outFile.write((const char *)&g, sizeof(g)) &&
+               outFile.write((const char *)tiles.data(), nT * sizeof(MapHash)));
+   } // saveGolden
+
+public:
+   Def2D    def;
+   size_t   tile[2];
+   std::vector<cl_uint> diverged;   // tile indices differing from golden at last check
+   bool     recorded, missing;      // golden result created / absent at last check
+
+   CMapChecksum (void) : idProg{0}, kT{0}, kR{0}, hT{0}, nT{0}, rws{CHK_ROOT_WS}, recorded{false}, missing{false}
+   {
+      def.x= def.y= 0; tile[0]= tile[1]= 0; goldKey[0]= 0;
+   }
+   ~CMapChecksum () { release(); }
+
+   // Build kernels & tile buffer in context of map. Tile sides must be powers of two,
+   // reduced (if necessary) to suit the device work group limit.
+   bool create (CMapImageOCL& m, const size_t t[2])
+   {
+      cl_int r;
+      char pre[1024];
+      const char *src[2]= { pre, checksumSrc };
+      const size_t maxWG= (m.dp.maxWG > 0) ? std::min<size_t>(m.dp.maxWG, CHK_LOCAL_MAX) : 256;
+
+      release();
+      if (m.isImage()) { return(false); }
+      mapLayoutSrc(pre, sizeof(pre), m.getHost());
+      def= m.getHost().def;
+      tile[0]= t[0]; tile[1]= t[1];
+      while ((tile[0] * tile[1]) > maxWG) { if (tile[0] >= tile[1]) { tile[0]>>= 1; } else { tile[1]>>= 1; } }
+      rws= std::min<size_t>(CHK_ROOT_WS, maxWG);
+      for (int d=0; d<2; d++) { ng[d]= (def.s[d] + tile[d] - 1) / tile[d]; }
+      nT= ng[0] * ng[1];
+      tiles.resize(nT);
+      hT= clCreateBuffer(m.ctx, CL_MEM_READ_WRITE, (nT + 1) * sizeof(MapHash), NULL, &r);
+      if (r >= 0) { idProg= clCreateProgramWithSource(m.ctx, 2, src, NULL, &r); }
+      if (r >= 0) { r= clBuildProgram(idProg, 0, NULL, NULL, NULL, NULL); }
+      if (r >= 0) { kT= clCreateKernel(idProg, "tileHash", &r); }
+      if (r >= 0) { kR= clCreateKernel(idProg, "rootHash", &r); }
+      return(r >= 0);
+   } // create
+
+   // Hash device map, reading back only the root. False on any enqueue or read error.
+   bool compute (CMapImageOCL& m, MapHash& root)
+   {
+      cl_mem hI= m.getDeviceMap();
+      size_t gws[2]= { ng[0] * tile[0], ng[1] * tile[1] };
+      cl_int r;
+
+      r= clSetKernelArg(kT, 0, sizeof(hT), &hT);
+      r|= clSetKernelArg(kT, 1, sizeof(hI), &hI);
+      r|= clSetKernelArg(kT, 2, sizeof(def), &def);
+      r|= clSetKernelArg(kR, 0, sizeof(hT), &hT);
+      r|= clSetKernelArg(kR, 1, sizeof(nT), &nT);
+      if (r >= 0) { r= clEnqueueNDRangeKernel(m.q, kT, 2, NULL, gws, tile, 0, NULL, NULL); }
+      if (r >= 0) { r= clEnqueueNDRangeKernel(m.q, kR, 1, NULL, &rws, &rws, 0, NULL, NULL); }
+      if (r >= 0) { r= clEnqueueReadBuffer(m.q, hT, CL_BLOCKING, nT * sizeof(MapHash), sizeof(root), &root, 0, NULL, NULL); }
+      return(r >= 0);
+   } // compute
+
+   // Tile hashes of last compute()
+   bool readTiles (cl_command_queue q)
+   {
+      return(clEnqueueReadBuffer(q, hT, CL_BLOCKING, 0, nT * sizeof(MapHash), tiles.data(), 0, NULL, NULL) >= 0);
+   } // readTiles
+
+   // Same hashes computed from a host map, e.g. to check a device or create golden results offline
+   MapHash host (const CMapImage2D& h)
+   {
+      MapHash root={0,0};
+      for (cl_uint g=0; g < nT; g++) { tiles[g].h[0]= tiles[g].h[1]= 0; }
+      for (size_t y=0; y < def.y; y++)
+      {
+         for (size_t x=0; x < def.x; x++)
+         {
+            const cl_uint i= y * def.x + x;
+            keyed(tiles[(y / tile[1]) * ng[0] + (x / tile[0])], h.pI[h.index(x,y)], i);
+         }
+      }
+      for (cl_uint g=0; g < nT; g++) { keyed(root, tiles[g].h[0], g); keyed(root, tiles[g].h[1], ~g); }
+      return(root);
+   } // host
+
+   // Compare device map with golden result <key> for the device of m, recording it
+   // instead if OCL_GOLDEN_RECORD=1. Returns number of diverging tiles (listed in
+   // diverged[]), or -1 on failure. Without golden result the comparison is skipped
+   // (missing set) and 0 returned.
+   int check (CMapImageOCL& m, const char key[])
+   {
+      const char *rec= getenv("OCL_GOLDEN_RECORD");
+      char devKey[sizeof(goldKey)];
+      MapHash root;
+
+      diverged.clear();
+      recorded= missing= false;
+      if (!compute(m, root)) { return(-1); }
+      snprintf(devKey, sizeof(devKey), "%s-%016llx", key, (unsigned long long)m.dp.idHash);
+      if (rec && (0 == strcmp(rec, "1")))
+      {
+         if (!readTiles(m.q) || !saveGolden(devKey, root)) { return(-1); }
+         recorded= loadGolden(devKey);
+         return(recorded ? 0 : -1);
+      }
+      if ((0 != strcmp(devKey, goldKey)) && !loadGolden(devKey)) { missing= true; return(0); }
+      if (root == goldRoot) { return(0); }
+      if (!readTiles(m.q)) { return(-1); }
+      for (cl_uint g=0; g < nT; g++) { if (tiles[g] != gold[g]) { diverged.push_back(g); } }
+      return(diverged.size());
+   } // check
+
+   // check() with report of outcome, listing origin of (up to) the first 8 diverging tiles
+   int verify (CMapImageOCL& m, const char key[])
+   {
+      const int d= check(m, key);
+      if (recorded) { std::cout << "golden result recorded: " << goldKey << std::endl; }
+      else if (missing) { std::cout << key << ": no reference for device " << m.dp.name << ", skipped (record with OCL_GOLDEN_RECORD=1)" << std::endl; }
+      else if (d > 0)
+      {
+         std::cout << key << ": " << d << " of " << nT << " tiles diverge from golden result, at";
+         for (int i=0; i < std::min(d, 8); i++)
+         {
+            size_t x, y;
+            origin(x, y, diverged[i]);
+            std::cout << " (" << x << "," << y << ")";
+         }
+         std::cout << std::endl;
+      }
+      else if (d < 0) { std::cout << key << ": golden verification failed" << std::endl; }
+      return(d);
+   } // verify
+
+   // Tile index to map coordinates (tile origin)
+   void origin (size_t& x, size_t& y, const cl_uint g) const { x= (g % ng[0]) * tile[0]; y= (g / ng[0]) * tile[1]; }
+
+   bool release (void)
+   {
+      if (0 != kT) { clReleaseKernel(kT); kT= 0; }
+      if (0 != kR) { clReleaseKernel(kR); kR= 0; }
+      if (0 != idProg) { clReleaseProgram(idProg); idProg= 0; }
+      if (0 != hT) { clReleaseMemObject(hT); hT= 0; }
+      gold.clear(); goldKey[0]= 0;
+      return(true);
+   } // release
+}; // CMapChecksum
+
+#endif // CHECKSUM_OCL_HPP
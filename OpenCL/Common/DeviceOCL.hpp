@@ -0,0 +1,195 @@
+// DeviceOCL.hpp - Typed device capability profile, cached in process and on disk.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Device limits are gathered once per device & driver: the profile file
+// (<dir>/ocldev-<key hash>.bin, dir given by environment variable
+// OCL_DEV_CACHE else /tmp) is reused by later runs, so only the name and
+// version strings forming the key need be queried. The key hashes the full
+// strings, the stored copies are truncated for display only.
+
+#ifndef DEVICE_OCL_HPP
+#define DEVICE_OCL_HPP
+
+#include <CL/cl.h>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <mutex>
+
+#define DEV_PROFILE_MAGIC  0x4F434C32   // change on layout revision
+#define DEV_PROFILE_MAX    8            // devices cached per process
+
+struct DeviceProfile
+{
+   uint32_t magic;
+   char     name[64], driver[32];       // identification (possibly truncated)
+   uint64_t idHash;                     // key: FNV-1a of full name & driver strings
+   cl_uint  computeUnits, maxClockMHz, addrAlignBits;
+   cl_uint  vecChar, vecInt, vecFloat, vecHalf, vecDouble; // preferred vector widths
+   size_t   maxWG, maxItem[3];          // work group size limits
+   cl_ulong localMem, globalMem, maxAlloc;
+   cl_command_queue_properties qProps;
+   cl_bool  fp16, fp64;
+
+   bool valid (void) const { return(DEV_PROFILE_MAGIC == magic); }
+
+   // Largest power of two square local work size within limits
+   size_t squareLWS (void) const
+   {
+      size_t l= 1;
+      while (((4 * l * l) <= maxWG) && ((2 * l) <= maxItem[0]) && ((2 * l) <= maxItem[1])) { l*= 2; }
+      return(l);
+   } // squareLWS
+}; // DeviceProfile
+
+// Whole token search of (space delimited) extension string
+bool findExtension (const char s[], const char ext[])
+{
+   const size_t l= strlen(ext);
+   const char *p= s;
+   while ((p= strstr(p, ext)))
+   {
+      if (((p == s) || (' ' == p[-1])) && ((0 == p[l]) || (' ' == p[l]))) { return(true); }
+      p+= l;
+   }
+   return(false);
+} // findExtension
+
+class CDeviceProfiles
+{
+protected:
+   cl_device_id   id[DEV_PROFILE_MAX];
+   DeviceProfile  prof[DEV_PROFILE_MAX];
+   int            n;
+   std::mutex     m;       // get() may be called from any thread (e.g. via CBuildOCL::create)
+
+   // FNV-1a continuation, terminator included to separate strings
+   static uint64_t fnv (uint64_t h, const char *s)
+   {
+      do { h= (h ^ (uint8_t)*s) * 0x100000001B3; } while (*s++);
+      return(h);
+   } // fnv
+
+   // Full length query: hash of the whole string returned, truncated copy kept in s
+   static uint64_t queryStr (char s[], size_t max, const cl_device_id d, const cl_device_info tok, uint64_t h)
+   {
+      size_t b= 0;
+      s[0]= 0;
+      if ((clGetDeviceInfo(d, tok, 0, NULL, &b) >= 0) && (b > 0))
+      {
+         char *t= new char[b+1];
+         if (clGetDeviceInfo(d, tok, b, t, NULL) >= 0)
+         {
+            t[b]= 0;
+            h= fnv(h, t);
+            strncpy(s, t, max-1);
+            s[max-1]= 0;
+         }
+         delete [] t;
+      }
+      return(h);
+   } // queryStr
+
+   template <typename T> static void query (T& v, const cl_device_id d, const cl_device_info tok)
+   {
+      memset(&v, 0, sizeof(v));
+      clGetDeviceInfo(d, tok, sizeof(v), &v, NULL);
+   } // query
+
+   static void path (char s[], size_t max, const DeviceProfile& p)
+   {
+      const char *dir= getenv("OCL_DEV_CACHE");
+      snprintf(s, max, "%s/ocldev-%016llx.bin", dir ? dir : "/tmp", (unsigned long long)p.idHash);
+   } // path
+
+   static void gather (DeviceProfile& p, const cl_device_id d)
+   {
+      query(p.computeUnits, d, CL_DEVICE_MAX_COMPUTE_UNITS);
+      query(p.maxClockMHz, d, CL_DEVICE_MAX_CLOCK_FREQUENCY);
+      query(p.addrAlignBits, d, CL_DEVICE_MEM_BASE_ADDR_ALIGN);
+      query(p.vecChar, d, CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR);
+      query(p.vecInt, d, CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT);
+      query(p.vecFloat, d, CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT);
+      query(p.vecHalf, d, CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF);
+      query(p.vecDouble, d, CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE);
+      query(p.maxWG, d, CL_DEVICE_MAX_WORK_GROUP_SIZE);
+      query(p.maxItem, d, CL_DEVICE_MAX_WORK_ITEM_SIZES);
+      query(p.localMem, d, CL_DEVICE_LOCAL_MEM_SIZE);
+      query(p.globalMem, d, CL_DEVICE_GLOBAL_MEM_SIZE);
+      query(p.maxAlloc, d, CL_DEVICE_MAX_MEM_ALLOC_SIZE);
+      query(p.qProps, d, CL_DEVICE_QUEUE_PROPERTIES);
+      p.fp16= p.fp64= CL_FALSE;
+      size_t b= 0;
+      if ((clGetDeviceInfo(d, CL_DEVICE_EXTENSIONS, 0, NULL, &b) >= 0) && (b > 1))
+      {
+         char *s= new char[b+1];
+         if (clGetDeviceInfo(d, CL_DEVICE_EXTENSIONS, b, s, NULL) >= 0)
+         {
+            s[b]= 0;
+            p.fp16= findExtension(s, "cl_khr_fp16");
+            p.fp64= findExtension(s, "cl_khr_fp64");
+         }
+         delete [] s;
+      }
+      p.magic= DEV_PROFILE_MAGIC;
+   } // gather
+
+   static bool load (DeviceProfile& p)
+   {
+      DeviceProfile f;
+      char s[256];
+      path(s, sizeof(s), p);
+      auto inFile= std::fstream(s, std::ios::in | std::ios::binary);
+      if (inFile.is_open() && inFile.read((char *)&f, sizeof(f)) && f.valid() &&
+         (f.idHash == p.idHash) && (0 == strcmp(f.name, p.name)) && (0 == strcmp(f.driver, p.driver)))
+      {
+         p= f;
+         return(true);
+      }
+      return(false);
+   } // load
+
+   static bool save (const DeviceProfile& p)
+   {
+      char s[256];
+      path(s, sizeof(s), p);
+      auto outFile= std::fstream(s, std::ios::out | std::ios::binary);
+      return(outFile.is_open() && outFile.write((const char *)&p, sizeof(p)));
+   } // save
+
+public:
+   size_t queries, loads; // full queries & disk cache hits
+
+   CDeviceProfiles (void) : n{0}, queries{0}, loads{0} { ; }
+
+   // Thread safe. Profile is filled once per device, no profile of a device in use
+   // should be evicted (more than DEV_PROFILE_MAX devices) while others are added.
+   const DeviceProfile& get (const cl_device_id d)
+   {
+      std::lock_guard<std::mutex> l(m);
+      for (int i=0; i<n; i++) { if (d == id[i]) { return(prof[i]); } }
+      const int i= (n < DEV_PROFILE_MAX) ? n++ : DEV_PROFILE_MAX-1; // overwrite last if full
+      DeviceProfile& p= prof[i];
+      memset(&p, 0, sizeof(p));
+      id[i]= d;
+      p.idHash= queryStr(p.name, sizeof(p.name), d, CL_DEVICE_NAME, 0xCBF29CE484222325);
+      p.idHash= queryStr(p.driver, sizeof(p.driver), d, CL_DRIVER_VERSION, p.idHash);
+      if (load(p)) { loads++; }
+      else
+      {
+         gather(p, d);
+         queries++;
+         save(p);
+      }
+      return(p);
+   } // get
+}; // CDeviceProfiles
+
+CDeviceProfiles gDevProfiles;
+
+const DeviceProfile& deviceProfile (const cl_device_id id) { return gDevProfiles.get(id); }
+
+#endif // DEVICE_OCL_HPP
@@ -0,0 +1,241 @@
+// Energy.hpp - Energy sampling alongside elapsed time (Linux powercap/RAPL, hwmon, INA sensors).
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Sensors are discovered under sysfs or named by the environment variable
+// OCL_ENERGY: "none", "rapl", "hwmon" or a file path. A path is read as an
+// accumulated energy counter in microjoules unless its name contains "power",
+// in which case it is an instantaneous power in microwatts (as hwmon). A plain
+// file rewritten by a script serves as stand-in for testing.
+// Attached to a CElapsedTime (pSink) the meter is sampled at every interval
+// boundary, power readings being integrated (trapezoidal) between samples.
+// Sensors update at ~1ms (RAPL) or slower (hwmon) so single short phases are
+// coarse: repeat frames for a meaningful per frame figure. RAPL counters cover
+// CPU packages (including integrated GPU) but not a discrete device, and may
+// be readable only by root on recent kernels.
+
+#ifndef ENERGY_HPP
+#define ENERGY_HPP
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glob.h>
+
+#include "Timing.hpp"
+
+typedef double EnergyValF; // Joules
+
+#define ENERGY_CHAN_MAX 8
+#define ENERGY_LOG_MAX  16
+
+enum EnergySource { ENS_NONE, ENS_RAPL, ENS_HWMON, ENS_FILE };
+
+// Sensor files & units
+struct EnergyPattern
+{
+   EnergySource   src;
+   const char     *glob;
+   double         scale;   // raw to Joules or Watts
+   bool           power;   // instantaneous power, else accumulated energy
+}; // EnergyPattern
+
+const EnergyPattern energyPatterns[]=
+{
+   { ENS_RAPL, "/sys/class/powercap/intel-rapl:[0-9]/energy_uj", 1E-6, false }, // packages only, sub-zones are contained
+   { ENS_HWMON, "/sys/class/hwmon/hwmon*/energy[0-9]_input", 1E-6, false },
+   { ENS_HWMON, "/sys/class/hwmon/hwmon*/power[0-9]_input", 1E-6, true },
+   { ENS_HWMON, "/sys/bus/i2c/drivers/ina3221x/*/iio:device*/in_power[0-9]_input", 1E-3, true } // Jetson (mW)
+};
+const int nEnergyPatterns= sizeof(energyPatterns) / sizeof(energyPatterns[0]);
+
+
+/***/
+
+// Single sensor file, held open and re-read from start
+struct EnergyChannel
+{
+   int      fd;
+   bool     power;
+   double   scale;
+   uint64_t range, last; // counter wrap (0 unknown), previous raw reading
+
+   EnergyChannel (void) : fd{-1}, power{false}, scale{0}, range{0}, last{0} { ; }
+
+   static bool readRaw (int fd, uint64_t& v)
+   {
+      char b[32];
+      ssize_t n= pread(fd, b, sizeof(b)-1, 0);
+      if (n <= 0) { return(false); }
+      b[n]= 0;
+      v= strtoull(b, NULL, 10);
+      return(true);
+   } // readRaw
+
+   bool open (const char path[], double s, bool p)
+   {
+      fd= ::open(path, O_RDONLY);
+      if ((fd >= 0) && readRaw(fd, last))
+      {
+         power= p; scale= s; range= 0;
+         if (!power)
+         {  // RAPL zone gives wrap point alongside counter
+            char r[256];
+            const char *e= strrchr(path, '/');
+            int l= e ? (e - path) : 0;
+            snprintf(r, sizeof(r), "%.*s/max_energy_range_uj", l, path);
+            int fr= ::open(r, O_RDONLY);
+            if (fr >= 0) { readRaw(fr, range); ::close(fr); }
+         }
+         return(true);
+      }
+      release();
+      return(false);
+   } // open
+
+   // Joules since previous sample, dt the interval for power integration
+   EnergyValF sample (TimeValF dt)
+   {
+      uint64_t v;
+      double d= 0;
+      if ((fd < 0) || !readRaw(fd, v)) { return(0); }
+      if (power) { d= 0.5 * ((double)v + last) * dt; }
+      else if (v >= last) { d= v - last; }
+      else if (range > last) { d= (range - last) + v; } // wrapped
+      last= v;
+      return(d * scale);
+   } // sample
+
+   void release (void) { if (fd >= 0) { ::close(fd); fd= -1; } }
+}; // EnergyChannel
+
+// Energy consumed between samples, summed over all channels of one source.
+// As interval sink a log of the most recent intervals is kept so that phase
+// energy can be matched to the timings of e.g. CMapImageOCL::execute().
+class CEnergyMeter : public CIntervalSink
+{
+protected:
+   EnergyChannel  ch[ENERGY_CHAN_MAX];
+   int            nCh;
+   EnergySource   src;
+   CTimestamp     clk;
+   TimeValF       tLast;
+   EnergyValF     log[ENERGY_LOG_MAX];
+   uint32_t       nLog;
+
+   int probe (const EnergyPattern& p)
+   {
+      glob_t g;
+      int n= 0;
+      if (0 == glob(p.glob, 0, NULL, &g))
+      {
+         for (size_t i=0; (i < g.gl_pathc) && (nCh < ENERGY_CHAN_MAX); i++)
+         {
+            if (ch[nCh].open(g.gl_pathv[i], p.scale, p.power)) { ++nCh; ++n; }
+         }
+         globfree(&g);
+      }
+      return(n);
+   } // probe
+
+   int probe (EnergySource s)
+   {
+      for (int i=0; (i < nEnergyPatterns) && (0 == nCh); i++)
+      {
+         if (s == energyPatterns[i].src) { probe(energyPatterns[i]); }
+      }
+      if (nCh > 0) { src= s; }
+      return(nCh);
+   } // probe
+
+public:
+   CEnergyMeter (void) : nCh{0}, src{ENS_NONE}, tLast{0}, nLog{0} { ; }
+   ~CEnergyMeter () { release(); }
+
+   // Discover sensors (or use those named by OCL_ENERGY) and take initial sample
+   bool open (void)
+   {
+      const char *e= getenv("OCL_ENERGY");
+
+      release();
+      if (e && (0 == strcmp(e, "none"))) { return(false); }
+      if (e && (0 == strcmp(e, "rapl"))) { probe(ENS_RAPL); }
+      else if (e && (0 == strcmp(e, "hwmon"))) { probe(ENS_HWMON); }
+      else if (e && e[0])
+      {
+         if (ch[0].open(e, 1E-6, NULL != strstr(e, "power"))) { nCh= 1; src= ENS_FILE; }
+      }
+      else if (0 == probe(ENS_RAPL)) { probe(ENS_HWMON); }
+      tLast= clk.get();
+      return(nCh > 0);
+   } // open
+
+   bool valid (void) const { return(nCh > 0); }
+
+   const char *name (void) const
+   {
+      static const char *n[]= { "none", "rapl", "hwmon", "file" };
+      return(n[src]);
+   } // name
+
+   int channels (void) const { return(nCh); }
+
+   // Joules (all channels) since previous sample
+   EnergyValF sample (TimeValF now=0)
+   {
+      EnergyValF j= 0;
+      if (now <= 0) { now= clk.get(); }
+      const TimeValF dt= (now > tLast) ? (now - tLast) : 0;
+      for (int i=0; i<nCh; i++) { j+= ch[i].sample(dt); }
+      tLast= now;
+      return(j);
+   } // sample
+
+   void interval (TimeValF now) override { log[nLog % ENERGY_LOG_MAX]= sample(now); nLog++; }
+
+   // Number of intervals logged, use as base index for joules()
+   uint32_t count (void) const { return(nLog); }
+
+   // Energy of logged interval i (0 if no longer held)
+   EnergyValF joules (uint32_t i) const
+   {
+      if ((i < nLog) && ((nLog - i) <= ENERGY_LOG_MAX)) { return(log[i % ENERGY_LOG_MAX]); }
+      return(0);
+   } // joules
+
+   void release (void)
+   {
+      for (int i=0; i<nCh; i++) { ch[i].release(); }
+      nCh= 0; src= ENS_NONE; nLog= 0;
+   } // release
+}; // CEnergyMeter
+
+// Repeat frame f() for at least minT seconds: returns frame count with energy & time over all frames
+template <typename F> uint32_t energyFrames (CEnergyMeter& m, F f, EnergyValF& j, TimeValF& t, const TimeValF minT=1)
+{
+   CElapsedTime clk;
+   uint32_t n= 0;
+
+   t= 0;
+   m.sample(clk.last);
+   do { f(); ++n; t+= clk.elapsed(); } while (t < minT);
+   j= m.sample(clk.last);
+   return(n);
+} // energyFrames
+
+// Print energy, mean power and optionally per frame & efficiency figures
+void energyReport (const char name[], EnergyValF j, TimeValF t, uint32_t frames=1, double flop=0)
+{
+   std::cout << "\t" << name << ": " << j << "J";
+   if (t > 0) { std::cout << " (" << j / t << "W)"; }
+   if (frames > 1) { std::cout << ", " << j / frames << "J/frame"; }
+   if ((flop > 0) && (j > 0)) { std::cout << ", " << 1E-9 * flop * frames / j << "GFLOP/W"; }
+   std::cout << std::endl;
+} // energyReport
+
+#endif // ENERGY_HPP
@@ -0,0 +1,313 @@
+// FuseOCL.hpp - Element-wise vector expressions fused into generated OpenCL kernels.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Arithmetic (+ - * /) on device vectors (DevVec) and scalars builds an
+// expression tree by value, nothing is computed until CVecExprOCL::eval().
+// Evaluation emits the tree as a single kernel "r[i]= <expression>" with one
+// pointer argument per distinct vector and one argument per scalar, so the
+// source depends only on the shape of the expression: kernels are cached by
+// source and scalar values change without rebuild. Unfused evaluation (one
+// kernel per operation, intermediate results in pooled temporary buffers) is
+// provided for comparison; global memory traffic of both is counted.
+// e.g. vx.eval(r, (a + b) * c - d) reads a,b,c,d and writes r once.
+
+#ifndef FUSE_OCL_HPP
+#define FUSE_OCL_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
+
+#include "SimpleOCL.hpp"
+#include "Timing.hpp"
+#include "BufferPool.hpp"
+
+#define FUSE_ARG_MAX 16 // distinct vector (and scalar) operands of one kernel
+
+// Vector of float on device
+struct DevVec
+{
+   cl_mem   h;
+   size_t   n;
+
+   DevVec (void) : h{0}, n{0} { ; }
+   size_t bytes (void) const { return(n * sizeof(cl_float)); }
+}; // DevVec
+
+
+/* Expression nodes: each emits itself to a kernel builder B */
+
+struct VecLeaf
+{
+   const DevVec *p;
+
+   template <typename B> void emit (B& b, bool root) const { b.vec(p->h); }
+}; // VecLeaf
+
+struct VecScalar
+{
+   cl_float v;
+
+   template <typename B> void emit (B& b, bool root) const { b.scalar(v); }
+}; // VecScalar
+
+template <typename L, typename R>
+struct VecBinOp
+{
+   char  op;
+   L     l;
+   R     r;
+
+   // Below the root an unfused builder evaluates the node into a temporary
+   template <typename B> void emit (B& b, bool root) const
+   {
+      if (!root && !b.fuse) { b.split(*this); return; }
+      b.put('('); l.emit(b, false); b.put(op); r.emit(b, false); b.put(')');
+   } // emit
+}; // VecBinOp
+
+// Operand types to expression nodes (undefined for anything else)
+template <typename T> struct VecNode { };
+template <> struct VecNode<DevVec>
+{
+   typedef VecLeaf type;
+   static VecLeaf wrap (const DevVec& v) { return VecLeaf{&v}; }
+};
+template <> struct VecNode<float>
+{
+   typedef VecScalar type;
+   static VecScalar wrap (float v) { return VecScalar{v}; }
+};
+template <> struct VecNode<double>
+{
+   typedef VecScalar type;
+   static VecScalar wrap (double v) { return VecScalar{(cl_float)v}; }
+};
+template <> struct VecNode<int>
+{
+   typedef VecScalar type;
+   static VecScalar wrap (int v) { return VecScalar{(cl_float)v}; }
+};
+template <typename L, typename R> struct VecNode< VecBinOp<L,R> >
+{
+   typedef VecBinOp<L,R> type;
+   static const VecBinOp<L,R>& wrap (const VecBinOp<L,R>& e) { return(e); }
+};
+
+// At least one operand must be a vector (or vector expression)
+template <typename T> struct IsVecExpr { static const bool value= false; };
+template <> struct IsVecExpr<DevVec> { static const bool value= true; };
+template <typename L, typename R> struct IsVecExpr< VecBinOp<L,R> > { static const bool value= true; };
+
+#define VEC_BIN_OP(SYM) \
+template <typename L, typename R, typename= typename std::enable_if<IsVecExpr<L>::value || IsVecExpr<R>::value>::type> \
+VecBinOp<typename VecNode<L>::type, typename VecNode<R>::type> operator SYM (const L& l, const R& r) \
+{ return { (#SYM)[0], VecNode<L>::wrap(l), VecNode<R>::wrap(r) }; }
+
+VEC_BIN_OP(+)
+VEC_BIN_OP(-)
+VEC_BIN_OP(*)
+VEC_BIN_OP(/)
+
+#undef VEC_BIN_OP
+
+struct FuseStats
+{
+   uint32_t builds, hits, launches;
+   size_t   bytes;   // global memory traffic: vector operands read plus result written
+
+   FuseStats (void) { clear(); }
+   void clear (void) { builds= hits= launches= 0; bytes= 0; }
+}; // FuseStats
+
+
+/***/
+
+// Evaluate vector expressions by generated kernels
+class CVecExprOCL : public CSimpleOCL, public CElapsedTime
+{
+protected:
+   struct FusedKern { cl_program p; cl_kernel k; };
+
+   std::unordered_map<std::string, FusedKern> cache; // by source
+   std::vector<DevVec>  temp;    // intermediate results of current (unfused) evaluation
+   cl_program           idFail;  // last failed build, for log
+
+   // Operands and expression text of one kernel
+   struct Builder
+   {
+      CVecExprOCL *pE;
+      std::string expr;
+      cl_mem      v[FUSE_ARG_MAX];
+      cl_float    s[FUSE_ARG_MAX];
+      int         nV, nS;
+      size_t      n;
+      bool        fuse, ok;
+
+      Builder (CVecExprOCL *p, size_t nElem, bool f) : pE{p}, nV{0}, nS{0}, n{nElem}, fuse{f}, ok{true} { ; }
+
+      void put (char c) { expr+= c; }
+
+      void vec (cl_mem h)
+      {
+         int i= 0;
+         while ((i < nV) && (v[i] != h)) { ++i; }
+         if (i >= FUSE_ARG_MAX) { ok= false; return; }
+         if (i == nV) { v[nV++]= h; }
+         expr+= "v" + std::to_string(i) + "[i]";
+      } // vec
+
+      void scalar (cl_float f)
+      {
+         if (nS >= FUSE_ARG_MAX) { ok= false; return; }
+         expr+= "s" + std::to_string(nS);
+         s[nS++]= f;
+      } // scalar
+
+      template <typename E> void split (const E& e) { cl_mem h= pE->temporary(e, n); if (h) { vec(h); } else { ok= false; } }
+   }; // Builder
+
+   std::string source (const Builder& b) const
+   {
+      std::string s= "kernel void fused (__global float *r";
+      for (int i=0; i<b.nV; i++) { s+= ", __global const float *v" + std::to_string(i); }
+      for (int i=0; i<b.nS; i++) { s+= ", const float s" + std::to_string(i); }
+      s+= ", const uint n)\n{ const uint i= get_global_id(0); if (i < n) { r[i]= " + b.expr + "; } }\n";
+      return(s);
+   } // source
+
+   cl_kernel kernel (const Builder& b)
+   {
+      const std::string src= source(b);
+      auto f= cache.find(src);
+      if (f != cache.end()) { stats.hits++; return(f->second.k); }
+
+      FusedKern e={0,0};
+      const char *s= src.c_str();
+      cl_int r;
+      e.p= clCreateProgramWithSource(ctx, 1, &s, NULL, &r);
+      if (r >= 0) { r= clBuildProgram(e.p, 0, NULL, NULL, NULL, NULL); }
+      if (r >= 0) { e.k= clCreateKernel(e.p, "fused", &r); }
+      if (r < 0)
+      {
+         if (idFail) { clReleaseProgram(idFail); }
+         idFail= e.p;
+         return(0);
+      }
+      stats.builds++;
+      cache[src]= e;
+      return(e.k);
+   } // kernel
+
+   cl_int launch (cl_mem hR, const Builder& b)
+   {
+      const cl_uint n= b.n;
+      size_t gws= ((b.n + lws - 1) / lws) * lws;
+      cl_kernel k= b.ok ? kernel(b) : 0;
+      cl_uint a= 0;
+      cl_int r= -1;
+
+      if (0 == k) { return(r); }
+      r= clSetKernelArg(k, a++, sizeof(hR), &hR);
+      for (int i=0; i<b.nV; i++) { r|= clSetKernelArg(k, a++, sizeof(b.v[i]), b.v+i); }
+      for (int i=0; i<b.nS; i++) { r|= clSetKernelArg(k, a++, sizeof(b.s[i]), b.s+i); }
+      r|= clSetKernelArg(k, a++, sizeof(n), &n);
+      if (r >= 0) { r= clEnqueueNDRangeKernel(q, k, 1, NULL, &gws, &lws, 0, NULL, NULL); }
+      stats.launches++;
+      stats.bytes+= (b.nV + 1) * b.n * sizeof(cl_float);
+      return(r);
+   } // launch
+
+   void releaseTemp (void)
+   {
+      for (DevVec& t : temp) { gDevPool.release(t.h, ctx, t.bytes(), CL_MEM_READ_WRITE); }
+      temp.clear();
+   } // releaseTemp
+
+public:
+   FuseStats   stats;
+   size_t      lws;
+
+   CVecExprOCL (void) : idFail{0}, lws{64} { ; }
+   ~CVecExprOCL () { release(); }
+
+   // Evaluate sub-expression into a temporary vector (unfused evaluation)
+   template <typename E> cl_mem temporary (const E& e, size_t n)
+   {
+      DevVec t;
+      cl_int r;
+      t.n= n;
+      t.h= gDevPool.acquire(ctx, t.bytes(), CL_MEM_READ_WRITE, &r);
+      if (r < 0) { return(0); }
+      temp.push_back(t);
+      Builder b(this, n, false);
+      e.emit(b, true);
+      return((launch(t.h, b) >= 0) ? t.h : 0);
+   } // temporary
+
+   bool vector (DevVec& v, size_t n)
+   {
+      cl_int r;
+      v.n= n;
+      v.h= clCreateBuffer(ctx, CL_MEM_READ_WRITE, v.bytes(), NULL, &r);
+      return(r >= 0);
+   } // vector
+
+   bool write (DevVec& v, const cl_float *p)
+   {
+      return(clEnqueueWriteBuffer(q, v.h, CL_BLOCKING, 0, v.bytes(), p, 0, NULL, NULL) >= 0);
+   } // write
+
+   bool read (cl_float *p, const DevVec& v)
+   {
+      return(clEnqueueReadBuffer(q, v.h, CL_BLOCKING, 0, v.bytes(), p, 0, NULL, NULL) >= 0);
+   } // read
+
+   bool release (DevVec& v)
+   {
+      cl_int r= 0;
+      if (0 != v.h) { r= clReleaseMemObject(v.h); v.h= 0; }
+      v.n= 0;
+      return(r >= 0);
+   } // release
+
+   // r= e over r.n elements, as one kernel or (!fuse) one per operation. Completes before return.
+   template <typename E> bool eval (DevVec& r, const E& e, bool fuse=true)
+   {
+      Builder b(this, r.n, fuse);
+      cl_int s;
+
+      VecNode<E>::wrap(e).emit(b, true);
+      s= launch(r.h, b);
+      if (s >= 0) { s= clFinish(q); }
+      releaseTemp();
+      return(s >= 0);
+   } // eval
+
+   void reportBuildLog (void)
+   {
+      size_t n= 0, maxLog= 1<<12;
+      char *log= new char[maxLog];
+      if (idFail && (clGetProgramBuildInfo(idFail, getDevice(), CL_PROGRAM_BUILD_LOG, maxLog, log, &n) >= 0) && (n > 1))
+      {
+         std::cout << "Fused Build Log:" << std::endl << log << std::endl;
+      }
+      delete [] log;
+   } // reportBuildLog
+
+   bool release (void)
+   {
+      releaseTemp();
+      for (auto& c : cache) { clReleaseKernel(c.second.k); clReleaseProgram(c.second.p); }
+      cache.clear();
+      if (idFail) { clReleaseProgram(idFail); idFail= 0; }
+      gDevPool.trim(ctx);
+      return CSimpleOCL::release();
+   } // release
+}; // CVecExprOCL
+
+#endif // FUSE_OCL_HPP
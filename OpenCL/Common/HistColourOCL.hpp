@@ -0,0 +1,151 @@
+// HistColourOCL.hpp - Histogram equalised colouring of map images on device.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Map, histogram and colour kernels are built as one program. Two device
+// passes follow the map kernel: a histogram of map values over [v0,v1) accumulated in
+// per work group (local memory) bins then merged into the global histogram
+// with atomics, followed by colour mapping in which each work group forms
+// the cumulative distribution in local memory and maps each value through it
+// to a palette. Values outside the range are black (e.g. Mandelbrot interior).
+// Colours are RGBA bytes so can be saved directly (CMapImage2D::save(name,0))
+// and converted e.g. "convert -size 512x512 -depth 8 RGBA:img.raw img.png"
+
+#ifndef HIST_COLOUR_OCL_HPP
+#define HIST_COLOUR_OCL_HPP
+
+#include "MapImageOCL.hpp"
+
+#define HIST_BINS 256
+
+
+/* OpenCL kernel sources */
+
+const char histColourSrc[]=
+"#define HIST_BINS 256\n" \
+"int bin (const int v, const int v0, const int v1)\n" \
+"{ return min(HIST_BINS-1, convert_int((v - v0) * ((float)HIST_BINS / (v1 - v0)))); }\n" \
+"\n" \
+"kernel void hist (__global uint *pH, __global const int *pI, const ushort2 def, const int v0, const int v1)\n" \
+"{ __local uint lH[HIST_BINS];\n" \
+"  const int l= get_local_id(1) * get_local_size(0) + get_local_id(0);\n" \
+"  const int nl= get_local_size(0) * get_local_size(1);\n" \
+"  const int x= get_global_id(0), y= get_global_id(1);\n" \
+"  for (int i= l; i < HIST_BINS; i+= nl) { lH[i]= 0; }\n" \
+"  barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"  if ((x < def.x) && (y < def.y)) {\n" \
+"    const int v= pI[y * def.x + x];\n" \
+"    if ((v >= v0) && (v < v1)) { atomic_inc(lH + bin(v, v0, v1)); } }\n" \
+"  barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"  for (int i= l; i < HIST_BINS; i+= nl) { if (lH[i] > 0) { atomic_add(pH + i, lH[i]); } } }\n" \
+"\n" \
+"uchar4 palette (const float t)\n" \
+"{ float3 c= 0.5f + 0.5f * cos(6.2831853f * (t + (float3)(0.0f, 0.1f, 0.2f)));\n" \
+"  return (uchar4)(convert_uchar3_sat_rte(255 * c), 0xFF); }\n" \
+"\n" \
+"kernel void colour (__global uchar4 *pC, const ushort2 def, __global const int *pI, __global const uint *pH, const int v0, const int v1)\n" \
+"{ __local uint lC[HIST_BINS];\n" \
+"  const int l= get_local_id(1) * get_local_size(0) + get_local_id(0);\n" \
+"  const int nl= get_local_size(0) * get_local_size(1);\n" \
+"  const int x= get_global_id(0), y= get_global_id(1);\n" \
+"  for (int i= l; i < HIST_BINS; i+= nl) { lC[i]= pH[i]; }\n" \
+"  barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"  if (0 == l) { for (int i=1; i < HIST_BINS; i++) { lC[i]+= lC[i-1]; } } // serial scan: trivial cost per group\n" \
+"  barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"  if ((x < def.x) && (y < def.y)) {\n" \
+"    const int v= pI[y * def.x + x];\n" \
+"    uchar4 c= (uchar4)(0,0,0,0xFF);\n" \
+"    if ((v >= v0) && (v < v1)) { c= palette((float)lC[bin(v, v0, v1)] / lC[HIST_BINS-1]); }\n" \
+"    pC[y * def.x + x]= c; } }\n";
+
+
+/***/
+
+// Map image with equalised colouring on device
+class CHistColourOCL : public CMapImageOCL
+{
+protected:
+   cl_kernel   kH, kC;  // registered
+   cl_mem      hH, hC;  // histogram & colour buffers
+
+public:
+   CHistColourOCL (void) : kH{0}, kC{0}, hH{0}, hC{0} { ; }
+   ~CHistColourOCL () { release(); }
+
+   // Map buffer is read by colouring kernels
+   bool createArgs (size_t w, size_t h)
+   {
+      cl_int r[2];
+      if (CMapImageOCL::createArgs(w, h, CL_MEM_READ_WRITE|CL_MEM_HOST_READ_ONLY))
+      {
+         hH= clCreateBuffer(ctx, CL_MEM_READ_WRITE, HIST_BINS * sizeof(cl_uint), NULL, r+0);
+         hC= clCreateBuffer(ctx, CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY, device.bytes, NULL, r+1);
+         return((r[0] >= 0) && (r[1] >= 0));
+      }
+      return(false);
+   } // createArgs
+
+   // Build map source (kernel <entryPoint> selected for execute()) together with colouring kernels
+   bool build (const char mapSrc[], const char entryPoint[])
+   {
+      const char *src[2]= { mapSrc, histColourSrc };
+      kH= kC= 0;
+      if (defaultBuild(src, 2, entryPoint))
+      {
+         kH= kernel("hist");
+         kC= kernel("colour");
+      }
+      return((0 != kH) && (0 != kC));
+   } // build
+
+   // Colour (device) map values in [v0,v1) then read back RGBA into host map.
+   // Timing in pDT[]: histogram, colour, read
+   bool equalise (const size_t lws[2], cl_int v0, cl_int v1, TimeValF *pDT=NULL)
+   {
+      size_t gws[2];
+      const cl_uint zero= 0;
+      cl_int r;
+
+      host.setGWS(gws, lws);
+      elapsed();
+      r= clEnqueueFillBuffer(q, hH, &zero, sizeof(zero), 0, HIST_BINS * sizeof(cl_uint), 0, NULL, NULL);
+      clSetKernelArg(kH, 0, sizeof(hH), &hH);
+      clSetKernelArg(kH, 1, sizeof(device.hI), &(device.hI));
+      clSetKernelArg(kH, 2, sizeof(host.def), &(host.def));
+      clSetKernelArg(kH, 3, sizeof(v0), &v0);
+      clSetKernelArg(kH, 4, sizeof(v1), &v1);
+      if (r >= 0) { r= clEnqueueNDRangeKernel(q, kH, 2, NULL, gws, lws, 0, NULL, NULL); }
+      clFinish(q);
+      if (pDT) { pDT[0]= elapsed(); }
+
+      clSetKernelArg(kC, 0, sizeof(hC), &hC);
+      clSetKernelArg(kC, 1, sizeof(host.def), &(host.def));
+      clSetKernelArg(kC, 2, sizeof(device.hI), &(device.hI));
+      clSetKernelArg(kC, 3, sizeof(hH), &hH);
+      clSetKernelArg(kC, 4, sizeof(v0), &v0);
+      clSetKernelArg(kC, 5, sizeof(v1), &v1);
+      if (r >= 0) { r= clEnqueueNDRangeKernel(q, kC, 2, NULL, gws, lws, 0, NULL, NULL); }
+      clFinish(q);
+      if (pDT) { pDT[1]= elapsed(); }
+
+      if (r >= 0) { r= clEnqueueReadBuffer(q, hC, CL_BLOCKING, 0, device.bytes, host.pI, 0, NULL, NULL); }
+      if (pDT) { pDT[2]= elapsed(); }
+      return(r >= 0);
+   } // equalise
+
+   bool readHist (cl_uint h[HIST_BINS])
+   {
+      return(clEnqueueReadBuffer(q, hH, CL_BLOCKING, 0, HIST_BINS * sizeof(cl_uint), h, 0, NULL, NULL) >= 0);
+   } // readHist
+
+   bool release (bool all=true)
+   {
+      kH= kC= 0; // released with program
+      if (0 != hH) { clReleaseMemObject(hH); hH= 0; }
+      if (0 != hC) { clReleaseMemObject(hC); hC= 0; }
+      return CMapImageOCL::release(all);
+   } // release
+}; // CHistColourOCL
+
+#endif // HIST_COLOUR_OCL_HPP
@@ -0,0 +1,177 @@
+// HostSIMD.hpp - Tuned host (CPU) baseline: persistent pinned threads with static partitions and explicit SIMD.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Each worker is pinned to a CPU and always handles the same partition of a
+// vector, so initialising data through the pool (first touch) places pages
+// on the NUMA node of the thread that later works on them. Vector loops use
+// AVX, SSE2 or NEON intrinsics as the compiler target allows (e.g. build
+// with -march=native for AVX on x86), otherwise scalar code.
+
+#ifndef HOST_SIMD_HPP
+#define HOST_SIMD_HPP
+
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define HOST_SIMD_NAME "AVX"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HOST_SIMD_NAME "SSE2"
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HOST_SIMD_NAME "NEON"
+#else
+#define HOST_SIMD_NAME "scalar"
+#endif
+
+#define HOST_PART_ALIGN 16 // partition boundary (elements): whole cache lines
+
+
+/***/
+
+// r[i]= a[i] + b[i]
+void simdAdd (float r[], const float a[], const float b[], const size_t n)
+{
+   size_t i= 0;
+#if defined(__AVX__)
+   for (; i + 8 <= n; i+= 8) { _mm256_storeu_ps(r+i, _mm256_add_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i))); }
+#elif defined(__SSE2__)
+   for (; i + 4 <= n; i+= 4) { _mm_storeu_ps(r+i, _mm_add_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i))); }
+#elif defined(__ARM_NEON)
+   for (; i + 4 <= n; i+= 4) { vst1q_f32(r+i, vaddq_f32(vld1q_f32(a+i), vld1q_f32(b+i))); }
+#endif
+   for (; i<n; i++) { r[i]= a[i] + b[i]; }
+} // simdAdd
+
+// Sum with two vector accumulators (hides add latency)
+float simdSum (const float v[], const size_t n)
+{
+   float s= 0;
+   size_t i= 0;
+#if defined(__AVX__)
+   __m256 s0= _mm256_setzero_ps(), s1= _mm256_setzero_ps();
+   for (; i + 16 <= n; i+= 16) { s0= _mm256_add_ps(s0, _mm256_loadu_ps(v+i)); s1= _mm256_add_ps(s1, _mm256_loadu_ps(v+i+8)); }
+   float t[8];
+   _mm256_storeu_ps(t, _mm256_add_ps(s0, s1));
+   for (int j=0; j<8; j++) { s+= t[j]; }
+#elif defined(__SSE2__)
+   __m128 s0= _mm_setzero_ps(), s1= _mm_setzero_ps();
+   for (; i + 8 <= n; i+= 8) { s0= _mm_add_ps(s0, _mm_loadu_ps(v+i)); s1= _mm_add_ps(s1, _mm_loadu_ps(v+i+4)); }
+   float t[4];
+   _mm_storeu_ps(t, _mm_add_ps(s0, s1));
+   for (int j=0; j<4; j++) { s+= t[j]; }
+#elif defined(__ARM_NEON)
+   float32x4_t s0= vdupq_n_f32(0), s1= vdupq_n_f32(0);
+   for (; i + 8 <= n; i+= 8) { s0= vaddq_f32(s0, vld1q_f32(v+i)); s1= vaddq_f32(s1, vld1q_f32(v+i+4)); }
+   float t[4];
+   vst1q_f32(t, vaddq_f32(s0, s1));
+   for (int j=0; j<4; j++) { s+= t[j]; }
+#endif
+   for (; i<n; i++) { s+= v[i]; }
+   return(s);
+} // simdSum
+
+
+/***/
+
+// Persistent worker threads, run() blocks until every worker has done its part
+class CHostThreads
+{
+protected:
+   std::vector<std::thread>   worker;
+   std::mutex                 m;
+   std::condition_variable    go, done;
+   std::function<void(int,int)> job;
+   uint32_t gen;
+   int      pending;
+   bool     quit;
+
+   static void pin (int i)
+   {
+#ifdef __linux__
+      cpu_set_t s;
+      CPU_ZERO(&s);
+      CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &s);
+      pthread_setaffinity_np(pthread_self(), sizeof(s), &s);
+#endif
+   } // pin
+
+   void loop (int i)
+   {
+      uint32_t seen= 0;
+      pin(i);
+      std::unique_lock<std::mutex> l(m);
+      for (;;)
+      {
+         go.wait(l, [&]{ return(quit || (gen != seen)); });
+         if (quit) { return; }
+         seen= gen;
+         l.unlock();
+         job(i, n);
+         l.lock();
+         if (0 == --pending) { done.notify_one(); }
+      }
+   } // loop
+
+public:
+   int n;
+
+   CHostThreads (int nT=0) : gen{0}, pending{0}, quit{false}
+   {
+      n= (nT > 0) ? nT : std::max(1u, std::thread::hardware_concurrency());
+      for (int i=0; i<n; i++) { worker.push_back(std::thread(&CHostThreads::loop, this, i)); }
+   }
+   ~CHostThreads ()
+   {
+      { std::lock_guard<std::mutex> l(m); quit= true; }
+      go.notify_all();
+      for (std::thread& t : worker) { t.join(); }
+   }
+
+   // f(part, parts) on every worker
+   void run (std::function<void(int,int)> f)
+   {
+      std::unique_lock<std::mutex> l(m);
+      job= f;
+      pending= n;
+      gen++;
+      go.notify_all();
+      done.wait(l, [&]{ return(0 == pending); });
+   } // run
+
+   // Range [i0,i1) of part i (of m) over n elements, same for every call with the same n
+   static void part (size_t& i0, size_t& i1, const size_t n, const int i, const int m)
+   {
+      const size_t s= ((n + m - 1) / m + HOST_PART_ALIGN - 1) & ~(size_t)(HOST_PART_ALIGN - 1);
+      i0= std::min(n, i * s);
+      i1= std::min(n, i0 + s);
+   } // part
+
+   void add (float r[], const float a[], const float b[], const size_t nE)
+   {
+      run([&](int i, int m){ size_t i0, i1; part(i0, i1, nE, i, m); simdAdd(r+i0, a+i0, b+i0, i1-i0); });
+   } // add
+
+   float sum (const float v[], const size_t nE)
+   {
+      std::vector<float> p(HOST_PART_ALIGN * n); // partial sums one cache line apart, no false sharing
+      float s= 0;
+      run([&](int i, int m){ size_t i0, i1; part(i0, i1, nE, i, m); p[HOST_PART_ALIGN * i]= simdSum(v+i0, i1-i0); });
+      for (int i=0; i<n; i++) { s+= p[HOST_PART_ALIGN * i]; }
+      return(s);
+   } // sum
+}; // CHostThreads
+
+#endif // HOST_SIMD_HPP
@@ -0,0 +1,220 @@
+// JobOCL.hpp - Thread safe map render job submission: many producer threads, one shared context & program.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Any host thread may submit() jobs; each is queued in one of two lanes
+// (interactive ahead of batch) and taken by the next free worker. Workers are
+// host threads each owning a command queue, a kernel object (so argument state
+// is never shared) and a device buffer, all created from one context and one
+// build. A job's result is read into its host map before its future is set.
+// Kernels follow the CMapImageOCL convention: (buffer, definition, geometry...).
+
+#ifndef JOB_OCL_HPP
+#define JOB_OCL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+#include "SimpleOCL.hpp"
+#include "Timing.hpp"
+#include "MapImageOCL.hpp"
+
+enum JobPriority { JP_INTERACTIVE, JP_BATCH };
+
+struct MapJob
+{
+   MapElement     *pI;  // result (host, def.x * def.y elements)
+   Def2D          def;
+   const GeomArgs *pA;  // geometry, valid until completion
+   JobPriority    pri;
+}; // MapJob
+
+struct JobStats
+{
+   uint32_t done[2], failed;
+   TimeValF latency[2], maxLatency[2]; // submission to completion: total & worst, per priority
+
+   JobStats (void) { clear(); }
+   void clear (void) { done[0]= done[1]= failed= 0; latency[0]= latency[1]= maxLatency[0]= maxLatency[1]= 0; }
+
+   TimeValF meanLatency (int p) const { return(done[p] ? latency[p] / done[p] : 0); }
+}; // JobStats
+
+class CJobServiceOCL
+{
+protected:
+   struct Entry
+   {
+      MapJob               j;
+      std::promise<bool>   done;
+      TimeValF             t0;
+   }; // Entry
+
+   struct Worker
+   {
+      cl_command_queue  q;
+      cl_kernel         k;
+      cl_mem            hI;
+      size_t            bytes;
+      std::thread       t;
+
+      Worker (void) : q{0}, k{0}, hI{0}, bytes{0} { ; }
+   }; // Worker
+
+   CBuildOCL            ocl;     // shared context & program
+   std::vector<Worker>  worker;
+   std::deque<Entry>    lane[2]; // by JobPriority
+   std::mutex           m;
+   std::condition_variable cv;
+   CTimestamp           clock;
+   JobStats             stats;
+   bool                 quit;    // no workers running: set (under m) unless between create() & release()
+
+   // Run job on worker's queue & kernel, read back result
+   bool render (Worker& w, const MapJob& j)
+   {
+      const size_t bytes= (size_t)j.def.x * j.def.y * sizeof(MapElement);
+      size_t gws[2];
+      Scalar derivArgs[2];
+      cl_int r= 0;
+
+      if (bytes > w.bytes)
+      {  // grow only
+         if (0 != w.hI) { clReleaseMemObject(w.hI); }
+         w.hI= clCreateBuffer(ocl.ctx, CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY, bytes, NULL, &r);
+         w.bytes= (r >= 0) ? bytes : 0;
+         if (r < 0) { w.hI= 0; return(false); }
+      }
+      r= clSetKernelArg(w.k, 0, sizeof(w.hI), &(w.hI));
+      r|= clSetKernelArg(w.k, 1, sizeof(j.def), &(j.def));
+      const uint8_t n= std::min<uint8_t>(GEOM_ARGS_MAX, j.pA->nArgs());
+      for (uint8_t i=0; i<n; i++)
+      {
+         size_t b=0;
+         const void *p= j.pA->get(b, i, derivArgs, &(j.def));
+         r|= clSetKernelArg(w.k, 2+i, b, p);
+      }
+      for (int d=0; d<2; d++) { gws[d]= lws[d] * ((j.def.s[d] + lws[d] - 1) / lws[d]); }
+      if (r >= 0) { r= clEnqueueNDRangeKernel(w.q, w.k, 2, NULL, gws, lws, 0, NULL, NULL); }
+      if (r >= 0) { r= clEnqueueReadBuffer(w.q, w.hI, CL_BLOCKING, 0, bytes, j.pI, 0, NULL, NULL); }
+      return(r >= 0);
+   } // render
+
+   void loop (int i)
+   {
+      std::unique_lock<std::mutex> l(m);
+      for (;;)
+      {
+         cv.wait(l, [&]{ return(quit || !lane[JP_INTERACTIVE].empty() || !lane[JP_BATCH].empty()); });
+         if (quit) { return; }
+         const int p= lane[JP_INTERACTIVE].empty() ? JP_BATCH : JP_INTERACTIVE;
+         Entry e= std::move(lane[p].front());
+         lane[p].pop_front();
+         l.unlock();
+         const bool ok= render(worker[i], e.j);
+         const TimeValF t= clock.get() - e.t0;
+         l.lock();
+         if (ok)
+         {
+            stats.done[p]++;
+            stats.latency[p]+= t;
+            stats.maxLatency[p]= std::max(stats.maxLatency[p], t);
+         }
+         else { stats.failed++; }
+         e.done.set_value(ok);
+      }
+   } // loop
+
+public:
+   size_t lws[2];
+
+   CJobServiceOCL (void) : quit{true} { lws[0]= lws[1]= 16; }
+   ~CJobServiceOCL () { release(); }
+
+   // Context & build shared by <nWorker> workers, each with queue & kernel <entryPoint>
+   bool create (cl_device_id id, const char src[], const char entryPoint[], const int nWorker)
+   {
+      cl_int r= 0;
+
+      release();
+      if (!ocl.create(id) || !ocl.defaultBuild(src, entryPoint)) { ocl.reportBuildLog(); return(false); }
+      if (ocl.dp.maxWG > 0) { while ((lws[0] * lws[1]) > ocl.dp.maxWG) { lws[ (lws[0] >= lws[1]) ? 0 : 1 ]>>= 1; } }
+      worker.resize(std::max(1, nWorker));
+      for (Worker& w : worker)
+      {
+#ifdef OPENCL_LIB_200
+         w.q= clCreateCommandQueueWithProperties(ocl.ctx, id, NULL, &r);
+#else
+         w.q= clCreateCommandQueue(ocl.ctx, id, 0, &r);
+#endif
+         if (r < 0) { w.q= 0; break; }
+         w.k= clCreateKernel(ocl.idProg, entryPoint, &r);
+         if (r < 0) { w.k= 0; break; }
+      }
+      if (r < 0) { release(); return(false); }
+      {
+         std::lock_guard<std::mutex> l(m);
+         quit= false;
+      }
+      for (size_t i=0; i < worker.size(); i++) { worker[i].t= std::thread(&CJobServiceOCL::loop, this, i); }
+      return(true);
+   } // create
+
+   int workers (void) const { return worker.size(); }
+
+   // Thread safe. Future is set (true on success) once the result is in j.pI,
+   // or immediately false when the service is not running
+   std::future<bool> submit (const MapJob& j)
+   {
+      Entry e;
+      std::future<bool> f= e.done.get_future();
+      e.j= j;
+      e.t0= clock.get();
+      {
+         std::lock_guard<std::mutex> l(m);
+         if (quit) { e.done.set_value(false); return(f); } // worker not touched, release() may be clearing it
+         lane[j.pri].push_back(std::move(e));
+      }
+      cv.notify_one();
+      return(f);
+   } // submit
+
+   JobStats getStats (bool clear=false)
+   {
+      std::lock_guard<std::mutex> l(m);
+      JobStats s= stats;
+      if (clear) { stats.clear(); }
+      return(s);
+   } // getStats
+
+   // Stop workers: jobs still queued fail
+   bool release (void)
+   {
+      {
+         std::lock_guard<std::mutex> l(m);
+         quit= true;
+      }
+      cv.notify_all();
+      for (Worker& w : worker)
+      {
+         if (w.t.joinable()) { w.t.join(); }
+         if (0 != w.hI) { clReleaseMemObject(w.hI); }
+         if (0 != w.k) { clReleaseKernel(w.k); }
+         if (0 != w.q) { clReleaseCommandQueue(w.q); }
+      }
+      worker.clear();
+      for (int p=0; p<2; p++)
+      {
+         for (Entry& e : lane[p]) { e.done.set_value(false); }
+         lane[p].clear();
+      }
+      return ocl.release(true);
+   } // release
+}; // CJobServiceOCL
+
+#endif // JOB_OCL_HPP
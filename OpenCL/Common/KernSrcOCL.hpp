@@ -0,0 +1,89 @@
+// KernSrcOCL.hpp - Kernel sources of the basic workloads (ocl1-3), shared by test programs.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Single definition of the vector add, index map, circle distance map and
+// Mandelbrot kernels. Programs needing a variant kernel (vectorised, profiled,
+// progressive ...) build their own entry point together with the shared
+// Mandelbrot functions (mandelFuncSrc). The Mandelbrot map kernel stores through
+// MAP_OUT / MAP_STORE when the program prefixes a map layout (buildLayout()),
+// otherwise row-major to a buffer; its iteration limit MAX_ITER may be set by
+// build option ("-D MAX_ITER=..."). Matching geometry arguments are given by
+// MapGeomOCL.hpp; this file has no dependencies so any program may include it.
+
+#ifndef KERN_SRC_OCL_HPP
+#define KERN_SRC_OCL_HPP
+
+/* OpenCL kernel sources */
+
+// r= a + b over n elements
+const char vecAddSrc[]=
+"kernel void vecAdd(__global float *pR, __global float *pA, __global float *pB, const uint n)\n" \
+"{ uint id= get_global_id(0); if (id < n) { pR[id]= pA[id] + pB[id]; } }";
+
+// Generate a simple map of element indices - easily verified
+const char idxKernSrc[]=
+"kernel void image (__global int *pI, const ushort2 def)\n" \
+"{ size_t x= get_global_id(0); if (x < def.x)" \
+"   { size_t y= get_global_id(1); if (y < def.y)" \
+"      {   size_t i= y * def.x + x;" // Compute 1D index using row stride <def.x>
+"          pI[i]= i; } } }";
+
+// Generate distance map of a circle - visually verifiable
+const char dmapKernSrc[]=
+"kernel void image (__global int *pI, const ushort2 def, const float2 c, const float r)\n" \
+"{ ushort2 u;"\
+"  float2 f;"\
+"  u.x= get_global_id(0);"\
+"  u.y= get_global_id(1);"\
+"  if ((u.x < def.x) && (u.y < def.y)) {" \
+"    f.x= u.x; f.y= u.y; "\
+"    int s= distance(f,c) - r;"\
+"    pI[(size_t)u.y * def.x + u.x]= s; } }";
+
+// Truncated distance map: values limited to t outside the circle, so pixels
+// further than r+t from the centre do not depend on the geometry
+const char dmapTKernSrc[]=
+"kernel void image (__global int *pI, const ushort2 def, const float2 c, const float r, const float t)\n" \
+"{ ushort2 u;"\
+"  float2 f;"\
+"  u.x= get_global_id(0);"\
+"  u.y= get_global_id(1);"\
+"  if ((u.x < def.x) && (u.y < def.y)) {" \
+"    f.x= u.x; f.y= u.y; "\
+"    int s= min(distance(f,c) - r, t);"\
+"    pI[(size_t)u.y * def.x + u.x]= s; } }";
+
+#define MANDEL_FUNC_SRC \
+"void csq1 (float2 *pV) { float ty= 2 * pV->x * pV->y; pV->x= pV->x * pV->x - pV->y * pV->y; pV->y= ty; }\n\n" \
+"float csqad1m2 (float2 *pV, const float2 *pC) { csq1(pV); *pV+= *pC; return dot(*pV,*pV); }\n\n" \
+"\n" \
+"int mandel (const float2 *pC, int maxI, float maxM2)\n" \
+"{ int i=0; float2 x= *pC;\n" \
+"  do { ++i;} while ((csqad1m2(&x, pC) < maxM2) && (i < maxI));\n" \
+"  return(i); }\n" \
+"\n"
+
+// Iteration functions only, for programs defining their own entry points
+const char mandelFuncSrc[]= MANDEL_FUNC_SRC;
+
+const char mandelKernSrc[]= MANDEL_FUNC_SRC
+"#ifndef MAX_ITER\n" \
+"#define MAX_ITER 256\n" \
+"#endif\n" \
+"#ifndef MAP_STORE\n" \
+"#define MAP_OUT __global int *\n" \
+"#define MAP_STORE(m,x,y,def,v) (m)[(size_t)(y) * (def).x + (x)]= (v)\n" \
+"#endif\n" \
+"kernel void image (MAP_OUT pI, const ushort2 def, const float2 c0, const float2 dc)\n" \
+"{ ushort2 u; float2 c;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    c.x= c0.x + dc.x * u.x;\n" \
+"    c.y= c0.y + dc.y * u.y;\n" \
+"    MAP_STORE(pI, u.x, u.y, def, mandel(&c, MAX_ITER, 1E12)); } }\n";
+
+#undef MANDEL_FUNC_SRC
+
+#endif // KERN_SRC_OCL_HPP
@@ -0,0 +1,106 @@
+// MapGeomOCL.hpp - Geometry arguments of the shared map kernels (KernSrcOCL.hpp).
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#ifndef MAP_GEOM_OCL_HPP
+#define MAP_GEOM_OCL_HPP
+
+#include <cmath>
+#include <algorithm>
+
+#include "MapImageOCL.hpp"
+
+struct Coord2D
+{
+   union { struct { Scalar x,y; }; Scalar s[2]; }; // anon
+
+   Coord2D (Scalar kx=0, Scalar ky=0) { x= kx; y= ky; }
+}; // Coord2D
+
+struct Complex2D
+{
+   union { struct { Scalar r,i; }; Scalar s[2]; }; // anon
+
+   Complex2D (Scalar kr=0, Scalar ki=0) { r= kr; i= ki; }
+}; // Complex2D
+
+// Circle centre & radius for dmapKernSrc, plus truncation <t> > 0 for dmapTKernSrc
+class DMapGeomArgs : public GeomArgs
+{
+public:
+   Scalar v[4];
+
+   DMapGeomArgs (const Coord2D& c, Scalar r, Scalar t=0)
+   {
+      v[0]= c.x; v[1]= c.y; v[2]= r; v[3]= t;
+   }
+   DMapGeomArgs (Scalar x, Scalar y, Scalar r, Scalar t=0) { v[0]= x; v[1]= y; v[2]= r; v[3]= t; }
+
+   void move (Scalar dx, Scalar dy) { v[0]+= dx; v[1]+= dy; }
+
+   uint8_t nArgs (void) const override { return((v[3] > 0) ? 3 : 2); }
+
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   {
+      switch(i)
+      {
+         case 0 :    bytes= 2 * sizeof(v[0]); return(v+0); // break;
+         case 1 :    bytes= sizeof(v[2]); return(v+2); // break;
+         case 2 :    bytes= sizeof(v[3]); return(v+3); // break;
+         default :   bytes= 0; return(NULL);
+      }
+   }
+
+   // Only when truncated: bounding square of radius r+t (plus rounding margin)
+   bool extent (MapRect& r, const Def2D& def) const override
+   {
+      if (v[3] <= 0) { return(false); }
+      const Scalar e= v[2] + v[3] + 1;
+      for (int d=0; d<2; d++)
+      {
+         const Scalar l= std::max<Scalar>(0, floorf(v[d] - e)), h= std::min<Scalar>(def.s[d], ceilf(v[d] + e) + 1);
+         r.o[d]= l;
+         r.s[d]= (h > l) ? (h - l) : 0;
+      }
+      return(true);
+   } // extent
+}; // DMapGeomArgs
+
+class MandelGeomArgs : public GeomArgs
+{
+public:
+   Scalar v[4];
+
+   MandelGeomArgs (const Complex2D& c, const Complex2D& sr) // complex plane origin+resolution specified using centre, semi-radii and pixel definition
+   {
+      v[0]= c.r-sr.r; v[1]= c.i-sr.i; // convert to lower bound
+      v[2]= 2 * sr.r; v[3]= 2 * sr.i; // convert to width (semi-diameters)
+   } // MandelGeomArgs
+
+   // Square view: centre & semi-radius
+   MandelGeomArgs (Scalar cr, Scalar ci, Scalar sr) : MandelGeomArgs(Complex2D(cr,ci), Complex2D(sr,sr)) { ; }
+
+   uint8_t nArgs (void) const override { return(2); }
+
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   {
+      switch(i)
+      {
+         case 1 :
+            if (pR && pD && (pD->x > 1) && (pD->y > 1))
+            {  // convert to resolution
+               pR[0]= v[2] / pD->x;
+               pR[1]= v[3] / pD->y;
+               bytes= 2 * sizeof(v[0]);
+               return(pR);
+            }
+         case 0 :
+            bytes= 2 * sizeof(v[0]);
+            return(v+2*i); // break;
+         default :   bytes= 0; return(NULL);
+      }
+   } // get
+}; // MandelGeomArgs
+
+#endif // MAP_GEOM_OCL_HPP
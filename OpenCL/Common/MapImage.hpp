@@ -7,8 +7,11 @@
 #define MAP_IMAGE_HPP
 
 #include <fstream>
+#include <cstring>
 //#include <iostream>
 
+#include "BufferPool.hpp"
+
 #ifdef DEBUG
 #include <cstdlib>
 #endif
@@ -17,23 +20,98 @@ typedef cl_ushort Def1D;
 typedef cl_ushort2 Def2D; // union members={ s[2]; (x,y); (s0,s1); (lo,hi); }
 typedef cl_int MapElement;
 
+// Element order in memory: row-major, square tiles (row-major within), or
+// Z-order (Morton) within square tiles. Tiles are in row-major order and the
+// map is padded to whole tiles. Kernels address elements through the MAP_IDX
+// macro (see mapLayoutSrc()), on the host use index(). Files are row-major.
+enum MapLayout { ML_ROW, ML_TILE, ML_MORTON };
+
+// Interleave low 16 bits with zeros (Morton order)
+inline uint32_t spreadBits (uint32_t v)
+{
+   v&= 0xFFFF;
+   v= (v | (v << 8)) & 0x00FF00FF;
+   v= (v | (v << 4)) & 0x0F0F0F0F;
+   v= (v | (v << 2)) & 0x33333333;
+   v= (v | (v << 1)) & 0x55555555;
+   return(v);
+} // spreadBits
+
+// Run of equal elements in a row, from x up to the next run (or end of row).
+// Runs of successive rows follow each other, every row beginning with x=0.
+struct MapRun
+{
+   MapElement  v;
+   cl_int      x;
+}; // MapRun
+
+#define MAP_RUN_MAGIC 0x454C5230 // "0RLE"
+
+struct MapRunHeader
+{
+   uint32_t magic;
+   uint16_t def[2];
+   uint64_t n;
+}; // MapRunHeader
+
 class CMapImage2D
 {
 public:
    MapElement *pI;
    Def2D       def;
+   MapLayout   layout;
+   uint8_t     ts;   // log2 tile side (ML_TILE, ML_MORTON)
 
-   CMapImage2D (void) : pI{NULL}, def{0,0} { ; }
+   CMapImage2D (void) : pI{NULL}, def{0,0}, layout{ML_ROW}, ts{0} { ; }
 
    size_t numElem (void) const { return((size_t)def.s0 * def.s1); }
 
+   // Tiles on each axis
+   size_t tilesX (void) const { return((def.x + (1 << ts) - 1) >> ts); }
+   size_t tilesY (void) const { return((def.y + (1 << ts) - 1) >> ts); }
+
+   // Elements stored, including padding to whole tiles
+   size_t numStore (void) const { return((ML_ROW == layout) ? numElem() : (tilesX() * tilesY()) << (2 * ts)); }
+
+   // Set before allocation: tile side 1<<s
+   bool setLayout (MapLayout l, uint8_t s=3)
+   {
+      if ((NULL != pI) || (s > 8)) { return(false); }
+      layout= l;
+      ts= (ML_ROW == l) ? 0 : s;
+      return(true);
+   } // setLayout
+
+   size_t index (size_t x, size_t y) const
+   {
+      if (ML_ROW == layout) { return(y * def.x + x); }
+      const size_t m= (1 << ts) - 1, t= (((y >> ts) * tilesX() + (x >> ts)) << (2 * ts));
+      if (ML_TILE == layout) { return(t + ((y & m) << ts) + (x & m)); }
+      return(t + (spreadBits(x & m) | (spreadBits(y & m) << 1)));
+   } // index
+
+   // Row y of map in row-major order
+   void getLine (MapElement line[], size_t y) const
+   {
+      if (ML_ROW == layout) { memcpy(line, pI + y * def.x, def.x * sizeof(*pI)); return; }
+      for (size_t x=0; x < def.x; x++) { line[x]= pI[index(x,y)]; }
+   } // getLine
+
+   void setLine (size_t y, const MapElement line[])
+   {
+      if (ML_ROW == layout) { memcpy(pI + y * def.x, line, def.x * sizeof(*pI)); return; }
+      for (size_t x=0; x < def.x; x++) { pI[index(x,y)]= line[x]; }
+   } // setLine
+
    size_t allocate (Def1D w, Def1D h)
    {
       if (NULL == pI)
       {
-         size_t n= (size_t)w * h;
-         pI= new MapElement[n];
-         if (pI) { def.x= w; def.y= h; return(n); }
+         def.x= w; def.y= h;
+         size_t n= numStore();
+         pI= (MapElement*) gHostPool.acquire(n * sizeof(*pI)); // recycled, aligned
+         if (pI) { return(n); }
+         def.x= def.y= 0;
       }
       return(0);
    } // allocate
@@ -42,13 +120,63 @@ public:
    {  // std::cout << "CMapImage::release()" << std::endl;
       if (pI)
       {
-         delete [] pI;
+         gHostPool.release(pI, numStore() * sizeof(*pI));
          pI= NULL;
          def.x= def.y= 0;
       }
       return(true);
    }// release
 
+   // Fill allocated map from n runs (row-major), returns elements written
+   size_t decode (const MapRun r[], const size_t n)
+   {
+      MapElement *pL= new MapElement[def.x];
+      size_t i= 0, e= 0;
+      for (int y=0; (y < def.y) && (i < n); y++)
+      {
+         size_t j= i + 1;
+         while ((j < n) && (r[j].x > 0)) { ++j; } // next row begins at x=0
+         for (size_t k=i; k<j; k++)
+         {
+            const int x1= (k+1 < j) ? std::min<int>(r[k+1].x, def.x) : def.x;
+            for (int x= std::max(0, r[k].x); x < x1; x++) { pL[x]= r[k].v; }
+         }
+         setLine(y, pL);
+         e+= def.x;
+         i= j;
+      }
+      delete [] pL;
+      return(e);
+   } // decode
+
+   // Write n runs of this map's definition (e.g. from CMapRLE) to file, returns bytes written
+   size_t saveRuns (const char fileName[], const MapRun r[], const size_t n) const
+   {
+      MapRunHeader h={ MAP_RUN_MAGIC, { def.x, def.y }, n };
+      auto outFile= std::fstream(fileName, std::ios::out | std::ios::binary);
+      if (outFile.is_open() && outFile.write((const char *)&h, sizeof(h)) && outFile.write((const char *)r, n * sizeof(*r)))
+      {
+         return(sizeof(h) + n * sizeof(*r));
+      }
+      return(0);
+   } // saveRuns
+
+   // Read file written by saveRuns(), allocate and decode: returns elements
+   size_t loadRuns (const char fileName[])
+   {
+      MapRunHeader h;
+      size_t e= 0;
+      auto inFile= std::fstream(fileName, std::ios::in | std::ios::binary);
+      if (inFile.is_open() && inFile.read((char *)&h, sizeof(h)) && (MAP_RUN_MAGIC == h.magic) && (allocate(h.def[0], h.def[1]) > 0) &&
+         (h.n <= (size_t)def.x * def.y)) // every run covers at least one element
+      {
+         MapRun *pR= new MapRun[h.n];
+         if (inFile.read((char *)pR, h.n * sizeof(*pR))) { e= decode(pR, h.n); }
+         delete [] pR;
+      }
+      return(e);
+   } // loadRuns
+
    void i2u8Hack (uint8_t u[], const int lineI[], const int nI) const
    {
       for (int i=0; i<nI; i++)
@@ -80,6 +208,47 @@ public:
       }
    } // i2rgbHack
 
+   // Read raw (headerless) image of given definition: inFmt= 1 for 8bit grey
+   // (e.g. ImageMagick: convert img.png -depth 8 gray:img.raw) or 0 for MapElement
+   size_t load (const char fileName[], Def1D w, Def1D h, uint8_t inFmt=1)
+   {
+      size_t n= 0;
+      auto inFile= std::fstream(fileName, std::ios::in | std::ios::binary);
+      if (inFile.is_open() && (allocate(w,h) > 0))
+      {
+         if (inFmt > 0)
+         {
+            uint8_t *pB = new uint8_t[def.x];
+            if (pB)
+            {
+               MapElement *pL= new MapElement[def.x];
+               for (int l=0; l<def.y; l++)
+               {
+                  if (!inFile.read((char *)pB, def.x)) { break; }
+                  for (int i=0; i<def.x; i++) { pL[i]= pB[i]; }
+                  setLine(l, pL);
+                  n+= def.x;
+               }
+               delete [] pL;
+               delete [] pB;
+            }
+         }
+         else if (ML_ROW == layout)
+         {
+            inFile.read((char *)pI, numElem() * sizeof(*pI));
+            n= inFile.gcount() / sizeof(*pI);
+         }
+         else
+         {
+            MapElement *pL= new MapElement[def.x];
+            for (int l=0; (l < def.y) && inFile.read((char *)pL, def.x * sizeof(*pL)); l++) { setLine(l, pL); n+= def.x; }
+            delete [] pL;
+         }
+         inFile.close();
+      }
+      return(n);
+   } // load
+
    size_t save (const char fileName[], uint8_t outFmt=3) const
    {
       size_t bytes= 0;
@@ -94,25 +263,37 @@ public:
             if ((outFmt > 1) && (3 != outFmt)) { outFmt= 1; }
             const size_t lineBytes= def.x * outFmt;
             uint8_t *pB = new uint8_t[lineBytes];
+            MapElement *pL= new MapElement[def.x];
             if (pB)
             {
-               size_t o= 0;
                for (int l=0; l<def.y; l++)
                {
-                  if (3 == outFmt) { i2rgbHack(pB, pI+o, def.x); }
-                  else { i2u8Hack(pB, pI+o, def.x); }
-                  o+= def.x;
+                  getLine(pL, l); // row-major
+                  if (3 == outFmt) { i2rgbHack(pB, pL, def.x); }
+                  else { i2u8Hack(pB, pL, def.x); }
                   outFile.write((const char *)pB, lineBytes);
                   bytes+= lineBytes;
                }
                delete [] pB;
             }
+            delete [] pL;
          }
-         else
+         else if (ML_ROW == layout)
          {
             bytes= n * sizeof(*pI);
             outFile.write((const char *)pI, bytes);
          }
+         else
+         {
+            MapElement *pL= new MapElement[def.x];
+            for (int l=0; l<def.y; l++)
+            {
+               getLine(pL, l);
+               outFile.write((const char *)pL, def.x * sizeof(*pL));
+               bytes+= def.x * sizeof(*pL);
+            }
+            delete [] pL;
+         }
          //if error bytes= 0;?
          outFile.close();
       }
@@ -12,9 +12,42 @@
 #include "Timing.hpp"
 #include "SimpleOCL.hpp"
 #include "MapImage.hpp"
+#include "ArgBindOCL.hpp"
 
 typedef float Scalar;
 
+// Maximum number of geometry arguments following the (buffer, definition) pair
+#define GEOM_ARGS_MAX 8
+
+// Axis aligned rectangle of map elements: origin & size
+struct MapRect
+{
+   size_t o[2], s[2];
+
+   bool empty (void) const { return((0 == s[0]) || (0 == s[1])); }
+
+   void merge (const MapRect& r)
+   {
+      if (r.empty()) { return; }
+      if (empty()) { *this= r; return; }
+      for (int d=0; d<2; d++)
+      {
+         size_t e= std::max(o[d] + s[d], r.o[d] + r.s[d]);
+         o[d]= std::min(o[d], r.o[d]);
+         s[d]= e - o[d];
+      }
+   } // merge
+
+   void clip (const Def2D& def)
+   {
+      for (int d=0; d<2; d++)
+      {
+         if (o[d] >= def.s[d]) { s[d]= 0; }
+         else { s[d]= std::min<size_t>(s[d], def.s[d] - o[d]); }
+      }
+   } // clip
+}; // MapRect
+
 // Abstract base class
 class GeomArgs
 {
@@ -23,7 +56,13 @@ public:
 
    virtual uint8_t nArgs (void) const = 0;
 
-   virtual const Scalar *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const = 0;
+   // Returned pointer is passed directly to clSetKernelArg() so may refer to any
+   // kernel argument type (float, double, cl_mem ...) of the given size in bytes
+   virtual const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const = 0;
+
+   // Bounding rectangle outside which map values do not depend on the arguments,
+   // if known. Allows incremental update of the map after an argument change.
+   virtual bool extent (MapRect& r, const Def2D& def) const { return(false); }
 }; // GeomArgs
 
 class EmptyGeomArgs : public GeomArgs
@@ -33,9 +72,61 @@ public:
 
    uint8_t nArgs (void) const override { return(0); }
 
-   const Scalar *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override { bytes=0; return(NULL); }
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override { bytes=0; return(NULL); }
 }; // EmptyGeomArgs
 
+/* Map layout (element index) macro MAP_IDX(x,y,def) for kernels, tile side 1<<MAP_TS */
+
+const char mapLayoutFmt[]=
+"#define MAP_TS %d\n" \
+"#define MAP_TM ((1u << MAP_TS) - 1)\n" \
+"#define MAP_TILE(x,y,def) ((((uint)(y) >> MAP_TS) * (((uint)(def).x + MAP_TM) >> MAP_TS) + ((uint)(x) >> MAP_TS)) << (2 * MAP_TS))\n" \
+"uint mapSpread (uint v) { v&= 0xFFFF; v= (v | (v << 8)) & 0x00FF00FFu; v= (v | (v << 4)) & 0x0F0F0F0Fu; v= (v | (v << 2)) & 0x33333333u; return((v | (v << 1)) & 0x55555555u); }\n" \
+"%s\n";
+
+const char *mapIdxDef[]=
+{
+   "#define MAP_IDX(x,y,def) ((size_t)(y) * (def).x + (x))", // ML_ROW
+   "#define MAP_IDX(x,y,def) (MAP_TILE(x,y,def) + (((uint)(y) & MAP_TM) << MAP_TS) + ((uint)(x) & MAP_TM))", // ML_TILE
+   "#define MAP_IDX(x,y,def) (MAP_TILE(x,y,def) + (mapSpread((uint)(x) & MAP_TM) | (mapSpread((uint)(y) & MAP_TM) << 1)))" // ML_MORTON
+};
+
+// Map kernel parameter types MAP_OUT & MAP_IN and stores MAP_STORE(m,x,y,def,v) of
+// an int value, MAP_STORE_RGBA(m,x,y,def,c) of a float4 colour, for a map buffer or image
+const char *mapStoreDef[]=
+{
+   "#define MAP_OUT __global int *\n" \
+   "#define MAP_IN __global const int *\n" \
+   "#define MAP_STORE(m,x,y,def,v) (m)[MAP_IDX(x,y,def)]= (v)\n" \
+   "#define MAP_STORE_RGBA(m,x,y,def,c) ((__global uchar4 *)(m))[MAP_IDX(x,y,def)]= convert_uchar4_sat_rte(255.0f * (c))\n", // buffer
+   "#define MAP_OUT write_only image2d_t\n" \
+   "#define MAP_IN read_only image2d_t\n" \
+   "#define MAP_STORE(m,x,y,def,v) write_imagei(m, (int2)(x,y), (int4)((v),0,0,0))\n" \
+   "#define MAP_STORE_RGBA(m,x,y,def,c) write_imagef(m, (int2)(x,y), c)\n" // image
+};
+
+// Kernel source prefix defining MAP_IDX for layout of map, and store macros for buffer or image
+int mapLayoutSrc (char s[], const int max, const CMapImage2D& m, const bool image=false)
+{
+   const int l= snprintf(s, max, mapLayoutFmt, m.ts, mapIdxDef[m.layout]);
+   if ((l < 0) || (l >= max)) { return(l); }
+   return(l + snprintf(s+l, max-l, "%s", mapStoreDef[image]));
+} // mapLayoutSrc
+
+// Image formats holding one MapElement per pixel that the generated image access
+// functions suit: signed 32bit map values (write_imagei, read_imagei) or
+// normalised 8bit RGBA colour (write_imagef). Other channel types would need
+// the matching access functions, calls mismatching the format are undefined.
+bool mapImageFormat (const cl_image_format& f)
+{
+   switch(f.image_channel_order)
+   {
+      case CL_R : return(CL_SIGNED_INT32 == f.image_channel_data_type);
+      case CL_RGBA : return(CL_UNORM_INT8 == f.image_channel_data_type);
+   }
+   return(false);
+} // mapImageFormat
+
 struct KernInfo
 {
    const char *src;
@@ -60,42 +151,90 @@ public:
 
    size_t nwg (size_t n, size_t l) const { return((n + l - 1) / l); }
 
-   // set work groups for local and global sizes on each axis
-   void setGWS (size_t gws[], const size_t l[]) const
+   // set work groups for local and global sizes on each axis, each
+   // work item covering a block of <vx> by <vy> adjacent elements
+   void setGWS (size_t gws[], const size_t l[], const size_t vx=1, const size_t vy=1) const
    {
-      for (int i=0; i<2; i++)
-      {
-         gws[i]= l[i] * nwg(def.s[i], l[i]);
-      }
+      gws[0]= l[0] * nwg(nwg(def.s[0], vx), l[0]);
+      gws[1]= l[1] * nwg(nwg(def.s[1], vy), l[1]);
    }
 }; // CMapImage
 
 struct DeviceArgs
 {
-   cl_mem hI; // device buffer "handle" identifiers
+   cl_mem hI; // device buffer (or image) "handle" identifiers
    size_t bytes;  // size of each buffer (on both host and device)
+   cl_context     ctx;  // of pooled buffer
+   cl_mem_flags   flags;
+   cl_image_format fmt;  // of image, desc.image_width zero for buffer
+   cl_image_desc  desc;
 
-   DeviceArgs (void) : hI{0}, bytes{0} { ; }
+   DeviceArgs (void) : hI{0}, bytes{0}, ctx{0}, flags{0}, fmt{0,0}, desc{} { ; }
 
-   bool allocate (size_t buffBytes, cl_context ctx)
+   bool isImage (void) const { return(desc.image_width > 0); }
+
+   bool allocate (size_t buffBytes, cl_context c, cl_mem_flags f=CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY)
    {
       cl_int r;
       if (buffBytes > 0)
       {
-         hI= clCreateBuffer(ctx, CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY, buffBytes, NULL, &r);
+         hI= gDevPool.acquire(c, buffBytes, f, &r); // may be larger than requested
          if (r >= 0)
          {
             bytes= buffBytes;
+            ctx= c; flags= f;
             return(true);
          }
       }
       return(false);
    } // allocate
 
-   bool release (void)
+   // 2D image of w*h pixels, not pooled (images are few and long lived)
+   bool allocateImage (size_t w, size_t h, cl_context c, const cl_image_format& f, cl_mem_flags mf)
    {
       cl_int r;
-      r= clReleaseMemObject(hI);
+      memset(&desc, 0, sizeof(desc));
+      desc.image_type= CL_MEM_OBJECT_IMAGE2D;
+      desc.image_width= w; desc.image_height= h;
+      hI= clCreateImage(c, mf, &f, &desc, NULL, &r);
+      if (r >= 0)
+      {
+         bytes= w * h * sizeof(MapElement);
+         ctx= c; flags= mf; fmt= f;
+         return(true);
+      }
+      hI= 0; desc.image_width= 0;
+      return(false);
+   } // allocateImage
+
+   // Another (unpooled) buffer or image of the same size and format
+   cl_mem createLike (cl_int *pR) const
+   {
+      if (isImage()) { return clCreateImage(ctx, flags, &fmt, &desc, NULL, pR); }
+      return clCreateBuffer(ctx, flags, bytes, NULL, pR);
+   } // createLike
+
+   // Blocking read of whole map (from hI or another object of the same kind)
+   cl_int read (cl_command_queue q, void *p, cl_mem h=0) const
+   {
+      if (0 == h) { h= hI; }
+      if (isImage())
+      {
+         const size_t o[3]= { 0, 0, 0 }, reg[3]= { desc.image_width, desc.image_height, 1 };
+         return clEnqueueReadImage(q, h, CL_BLOCKING, o, reg, 0, 0, p, 0, NULL, NULL);
+      }
+      return clEnqueueReadBuffer(q, h, CL_BLOCKING, 0, bytes, p, 0, NULL, NULL);
+   } // read
+
+   bool release (void)
+   {
+      cl_int r= 0;
+      if (isImage())
+      {
+         if (0 != hI) { r= clReleaseMemObject(hI); }
+         desc.image_width= 0;
+      }
+      else { r= gDevPool.release(hI, ctx, bytes, flags); }
       hI= 0;
       std::cout << "DeviceArgs::release() - r=" << r << std::endl;
       return(r >= 0);
@@ -111,80 +250,253 @@ protected:
 
    HostArgs    host;
    DeviceArgs  device;
+   char        layoutSrc[2048]; // MAP_IDX & store prefix, see buildLayout()
+   size_t      itemW, itemH;   // elements per work item (horizontal & vertical)
+   MapRect     prev, dirty;    // extent of last geometry & last updated region
+   bool        prevValid;
+   cl_kernel   mapBound;       // kernel holding current map buffer & definition args
+   const void  *pBound;        // typed args (KernArgs) last bound, NULL after GeomArgs
+   uint32_t    boundSeq;       // build sequence of above (kernel handles may be reused)
+
+   // Set map buffer & definition arguments on kernel, if not already
+   cl_int setMapArgs (void)
+   {
+      cl_int r= 0;
+      if (boundSeq != buildSeq) { mapBound= 0; pBound= NULL; boundSeq= buildSeq; }
+      if (mapBound != CBuildOCL::idKern)
+      {
+         r= clSetKernelArg(CBuildOCL::idKern, 0, sizeof(device.hI), &(device.hI));
+         r|= clSetKernelArg(CBuildOCL::idKern, 1, sizeof(host.def), &(host.def));
+         mapBound= (r >= 0) ? CBuildOCL::idKern : 0;
+      }
+      return(r);
+   } // setMapArgs
+
+   // Set map buffer, definition & geometry arguments on kernel
+   cl_int setArgs (const GeomArgs& ga)
+   {
+      cl_int r;
+      Scalar derivArgs[2];
+
+      r= setMapArgs();
+      pBound= NULL;
+      const uint8_t n= std::min<uint8_t>(GEOM_ARGS_MAX, ga.nArgs());
+      for (uint8_t i=0; i<n; i++)
+      {
+         size_t b=0;
+         const void *p= ga.get(b, i, derivArgs, &(host.def));
+         r|= clSetKernelArg(CBuildOCL::idKern, 2+i, b, p);
+      }
+      return(r);
+   } // setArgs
 
 public:
-   bool createArgs (size_t w, size_t h)
+   // Flags may be changed e.g. to CL_MEM_READ_WRITE when the map is input to further kernels
+   bool createArgs (size_t w, size_t h, cl_mem_flags f=CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY)
    {
-      return device.allocate( host.allocate(w,h), CSimpleOCL::ctx );
+      const size_t b= host.allocate(w,h); // numStore() bytes: padded to whole tiles
+      mapBound= 0;
+      if ((dp.maxAlloc > 0) && (b > dp.maxAlloc)) { return(false); } // beyond device limit
+      return device.allocate( b, CSimpleOCL::ctx, f );
    } // createArgs
 
-   CMapImageOCL () { ; }
+   // Device of context supports images at all
+   bool imageSupport (void)
+   {
+      cl_bool img= CL_FALSE;
+      if (clGetDeviceInfo(getDevice(), CL_DEVICE_IMAGE_SUPPORT, sizeof(img), &img, NULL) < 0) { return(false); }
+      return(CL_FALSE != img);
+   } // imageSupport
+
+   // Map as 2D image instead of buffer (row-major layout only): CL_R with a signed
+   // 32bit channel for map values (MAP_STORE) or CL_RGBA with normalised 8bit channels
+   // for colour (MAP_STORE_RGBA), either way one MapElement per pixel on the host
+   // (see mapImageFormat). Devices may store images in texture friendly order and
+   // further kernels can read the map by sampler, with boundary handling by
+   // addressing mode. False if unsupported.
+   bool createImage (size_t w, size_t h, cl_channel_order o=CL_R, cl_channel_type t=CL_SIGNED_INT32, cl_mem_flags f=CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY)
+   {
+      const cl_image_format fmt= { o, t };
+
+      if (!imageSupport() || (ML_ROW != host.layout) || !mapImageFormat(fmt)) { return(false); }
+      mapBound= 0;
+      return((host.allocate(w,h) > 0) && device.allocateImage(w, h, CSimpleOCL::ctx, fmt, f));
+   } // createImage
+
+   // Reduce local work size (halving) to fit device limits, returns true if unchanged
+   bool fitLWS (size_t lws[2]) const
+   {
+      const size_t l[2]= { lws[0], lws[1] };
+      if (dp.maxWG > 0)
+      {
+         for (int d=0; d<2; d++) { while ((lws[d] > 1) && (lws[d] > dp.maxItem[d])) { lws[d]>>= 1; } }
+         while ((lws[0] * lws[1]) > dp.maxWG) { lws[ (lws[0] >= lws[1]) ? 0 : 1 ]>>= 1; }
+      }
+      return((l[0] == lws[0]) && (l[1] == lws[1]));
+   } // fitLWS
+
+   CMapImageOCL () : itemW{1}, itemH{1}, prevValid{false}, mapBound{0}, pBound{NULL}, boundSeq{0} { layoutSrc[0]= 0; }
    ~CMapImageOCL () { release(); }
 
+   // Set number of horizontally adjacent elements computed by each work item (vector kernels)
+   void setItemWidth (size_t w) { if (w > 0) { itemW= w; } }
+
+   // Memory layout of map (host and device), set before createArgs()
+   bool setLayout (MapLayout l, uint8_t tileShift=3) { return host.setLayout(l, tileShift); }
+
+   // Build map kernel source (addressing elements by MAP_IDX, or storing by MAP_STORE
+   // to a MAP_OUT parameter for buffer or image) for the current layout
+   bool buildLayout (const char src[], const char entryPoint[]) { return buildLayout(&src, 1, entryPoint); }
+
+   bool buildLayout (const char *srcTab[], const int nSrc, const char entryPoint[])
+   {
+      const char *tab[4]= { layoutSrc, };
+      if ((nSrc < 1) || (nSrc > 3)) { return(false); }
+      for (int i=0; i<nSrc; i++) { tab[1+i]= srcTab[i]; }
+      mapLayoutSrc(layoutSrc, sizeof(layoutSrc), host, device.isImage());
+      return defaultBuild(tab, 1+nSrc, entryPoint);
+   } // buildLayout
+
+   // Set block of elements covered by each work item (e.g. coarse passes of progressive rendering)
+   void setItemSize (size_t w, size_t h) { if ((w > 0) && (h > 0)) { itemW= w; itemH= h; } }
+
    //defaultBuild
 
-   bool execute (size_t lws[2], const GeomArgs& ga, TimeValF *pDT=NULL)
+   // Run kernel (args already set) over whole map, then (optionally) read back map.
+   // Timing in pDT[]: kernel, read
+   bool run (size_t lws[2], TimeValF *pDT=NULL, bool readBack=true)
    {
       size_t gws[2];
-      cl_event evt[2];
-      cl_int r, wr[2], ar[4];
-      Scalar derivArgs[2];
+      cl_int r;
 
-      host.setGWS(gws, lws);
+      host.setGWS(gws, lws, itemW, itemH);
       //std::cout << "lws: " << lws[0] << ", " << lws[1] << std::endl;
       //std::cout << "gws: " << gws[0] << ", " << gws[1] << std::endl;
-
-      // Set args on device
-      ar[0]= clSetKernelArg(CBuildOCL::idKern, 0, sizeof(device.hI), &(device.hI));
-      ar[1]= clSetKernelArg(CBuildOCL::idKern, 1, sizeof(host.def), &(host.def));
-      const uint8_t n= ga.nArgs();
-      if (n > 0)
-      {
-         size_t b=0;
-         const Scalar *p= ga.get(b,0);
-         ar[2]= clSetKernelArg(CBuildOCL::idKern, 2, b, p);
-         if (n > 1)
-         {
-            p= ga.get(b, 1, derivArgs, &(host.def));
-            ar[3]= clSetKernelArg(CBuildOCL::idKern, 3, b, p);
-         }
-      }
-      if (pDT) { pDT[0]= elapsed(); }
-      //std::cout << "ar: " << ar[0] << ", " << ar[1] << std::endl;
-
       try
       {  // Submit kernel job
-         r= clEnqueueNDRangeKernel(CSimpleOCL::q, CBuildOCL::idKern, 2, NULL, gws, lws, 0, NULL, evt+0);
+         r= clEnqueueNDRangeKernel(CSimpleOCL::q, CBuildOCL::idKern, 2, NULL, gws, lws, 0, NULL, NULL);
 
          if (r >= 0)
          {
-            std::cout << "kernel enqueued" << std::endl;
+            //std::cout << "kernel enqueued" << std::endl;
             r= clFinish(CSimpleOCL::q); // Global sync
 
-            if (pDT) { pDT[1]= elapsed(); }
-            std::cout << "kernel completion= " << r << std::endl;
+            if (pDT) { pDT[0]= elapsed(); }
+            //std::cout << "kernel completion= " << r << std::endl;
 
             // Read the results (sync.) from the device
-            r= clEnqueueReadBuffer(CSimpleOCL::q, device.hI, CL_BLOCKING, 0, device.bytes, host.pI, 0, NULL, evt+1);
-            if (pDT) { pDT[2]= elapsed(); }
+            if (readBack) { r= device.read(CSimpleOCL::q, host.pI); }
+            if (pDT) { pDT[1]= elapsed(); }
             //std::cout << "buffer read complete" << std::endl;
          }
          else { std::cout << "enqueue r=" << r << std::endl; }
       } catch (const std::exception& e) { std::cout << "EXCEPT: " << e.what() << std::endl; }
-
       return(r >= 0);
+   } // run
+
+   // Transfer device map to host (e.g. after execute() without read back)
+   bool read (void) { return(device.read(CSimpleOCL::q, host.pI) >= 0); }
+
+   // Transfer leading n elements of device buffer to p[] (e.g. compacted results of a partial pass)
+   bool read (MapElement p[], size_t n)
+   {
+      if (device.isImage() || ((n * sizeof(*p)) > device.bytes)) { return(false); }
+      return(clEnqueueReadBuffer(CSimpleOCL::q, device.hI, CL_BLOCKING, 0, n * sizeof(*p), p, 0, NULL, NULL) >= 0);
+   } // read
+
+   // Set args & run kernel, then (optionally) read back map. Timing in pDT[]: args, kernel, read
+   bool execute (size_t lws[2], const GeomArgs& ga, TimeValF *pDT=NULL, bool readBack=true)
+   {
+      bool r;
+
+      // Set args on device
+      setArgs(ga);
+      if (pDT) { pDT[0]= elapsed(); }
+      r= run(lws, pDT ? pDT+1 : NULL, readBack);
+
+      prevValid= ga.extent(prev, host.def);
+      dirty.o[0]= dirty.o[1]= 0;
+      dirty.s[0]= host.def.x; dirty.s[1]= host.def.y;
+      return(r);
+   } // execute
+
+   // As execute() but with typed arguments following (map buffer, definition):
+   // only changed values are set on the kernel. Extent (dirty region) is not tracked.
+   template <typename... T> bool execute (size_t lws[2], KernArgs<T...>& ka, TimeValF *pDT=NULL, bool readBack=true)
+   {
+      cl_int r;
+
+      r= setMapArgs();
+      if (pBound != &ka) { ka.invalidate(); pBound= &ka; }
+      if (r >= 0) { r= ka.bind(CBuildOCL::idKern, 2); }
+      if (pDT) { pDT[0]= elapsed(); }
+      prevValid= false;
+      return((r >= 0) && run(lws, pDT ? pDT+1 : NULL, readBack));
    } // execute
 
+   // Re-run kernel (as last executed) for changed geometry over only the region
+   // affected: the union of previous and current extent. The launch uses a global
+   // offset and only the dirty rectangle is read back to the host map.
+   // Falls back to execute() if either extent is unknown, work items cover
+   // multiple elements, the layout is not row-major or the map is an image.
+   // Timing as execute()
+   bool update (size_t lws[2], const GeomArgs& ga, TimeValF *pDT=NULL)
+   {
+      MapRect cur;
+      size_t gwo[2], gws[2];
+      cl_int r;
+
+      if (!prevValid || (itemW * itemH > 1) || (ML_ROW != host.layout) || device.isImage() || !ga.extent(cur, host.def)) { return execute(lws, ga, pDT); }
+      dirty= prev;
+      dirty.merge(cur);
+      dirty.clip(host.def);
+      prev= cur;
+      r= setArgs(ga);
+      if (pDT) { pDT[0]= elapsed(); }
+      if (dirty.empty()) { if (pDT) { pDT[1]= pDT[2]= 0; } return(r >= 0); }
+
+      for (int d=0; d<2; d++)
+      {  // whole work groups (elements beyond map are ignored by kernel)
+         gwo[d]= dirty.o[d];
+         gws[d]= lws[d] * host.nwg(dirty.s[d], lws[d]);
+      }
+      if (r >= 0) { r= clEnqueueNDRangeKernel(CSimpleOCL::q, CBuildOCL::idKern, 2, gwo, gws, lws, 0, NULL, NULL); }
+      if (r >= 0) { r= clFinish(CSimpleOCL::q); }
+      if (pDT) { pDT[1]= elapsed(); }
+      if (r >= 0)
+      {
+         const size_t b= sizeof(*(host.pI)), pitch= host.def.x * b;
+         const size_t o[3]= { dirty.o[0] * b, dirty.o[1], 0 }, reg[3]= { dirty.s[0] * b, dirty.s[1], 1 };
+         r= clEnqueueReadBufferRect(CSimpleOCL::q, device.hI, CL_BLOCKING, o, o, reg, pitch, 0, pitch, 0, host.pI, 0, NULL, NULL);
+      }
+      if (pDT) { pDT[2]= elapsed(); }
+      return(r >= 0);
+   } // update
+
+   // Region computed by last execute() or update()
+   const MapRect& getDirty (void) const { return(dirty); }
+
    bool release (bool all=true)
    {
       bool r= host.release() && device.release();
-      if (all) { r&= CBuildOCL::release(all); }
+      if (all)
+      {
+         gDevPool.trim(ctx); // pooled buffers must not outlive context
+         r&= CBuildOCL::release(all);
+      }
       return(r);
    }
 
    friend int verify (const CMapImageOCL&);
 
-   size_t save (const char fileName[]) { return host.save(fileName); }
+   const HostArgs& getHost (void) const { return(host); }
+
+   // Map buffer (or image) on device, for further kernels (map created with CL_MEM_READ_WRITE)
+   cl_mem getDeviceMap (void) const { return(device.hI); }
+
+   bool isImage (void) const { return device.isImage(); }
+
+   size_t save (const char fileName[], uint8_t outFmt=3) { return host.save(fileName, outFmt); }
 }; // CMapImageOCL
 
 #endif // MAP_IMAGE_OCL_HPP
@@ -0,0 +1,372 @@
+// PrimMapOCL.hpp - Signed distance map of many primitives, using tile binning.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// The map is the union (minimum) of signed distances to all primitives. The
+// image is divided into square tiles (one work group each) and every tile is
+// evaluated only against those primitives that could be nearest to some pixel
+// within it. As a signed distance field is 1-Lipschitz, distance at the tile
+// centre +/- the tile semi-diagonal bounds distance over the whole tile; any
+// primitive whose lower bound exceeds the least upper bound can be culled.
+// Candidates are found by searching rings of cells (about the tile) in a grid
+// of primitive bounding boxes, stopping once the ring distance exceeds that
+// least upper bound, so the result is exact (identical to naive evaluation).
+
+#ifndef PRIM_MAP_OCL_HPP
+#define PRIM_MAP_OCL_HPP
+
+#include <cmath>
+#include <algorithm>
+
+#include "MapImageOCL.hpp"
+
+// Tile edge (pixels) == work group local size on each axis
+#define PRIM_TILE    16
+// Primitives staged in local memory per pass
+#define PRIM_CHUNK   256
+
+
+/* OpenCL kernel sources */
+
+// Primitive as float8: (x0, y0, x1, y1, r, type, -, -)
+//    circle:  centre (x0,y0), radius r
+//    segment: end points (x0,y0)-(x1,y1), semi-thickness r (capsule)
+//    box:     centre (x0,y0), semi-extent (x1,y1), corner radius r
+const char primSDFSrc[]=
+"float sdPrim (const float2 p, const float8 g)\n" \
+"{ switch((int)g.s5) {\n" \
+"    case 0 : return distance(p, g.s01) - g.s4;\n" \
+"    case 1 : { float2 pa= p - g.s01, ba= g.s23 - g.s01;\n" \
+"      float h= clamp(dot(pa,ba) / dot(ba,ba), 0.0f, 1.0f);\n" \
+"      return length(pa - ba * h) - g.s4; }\n" \
+"    case 2 : { float2 d= fabs(p - g.s01) - g.s23;\n" \
+"      return length(fmax(d, (float2)(0.0f))) + fmin(fmax(d.x, d.y), 0.0f) - g.s4; }\n" \
+"  }\n" \
+"  return(MAXFLOAT); }\n\n";
+
+// Evaluate every primitive at every pixel
+const char primNaiveSrc[]=
+"kernel void image (__global int *pI, const ushort2 def, __global const float8 *pP, const int nP)\n" \
+"{ ushort2 u;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    const float2 p= (float2)(u.x, u.y);\n" \
+"    float s= MAXFLOAT;\n" \
+"    for (int i=0; i<nP; i++) { s= fmin(s, sdPrim(p, pP[i])); }\n" \
+"    pI[(size_t)u.y * def.x + u.x]= convert_int_sat(s); } }\n";
+
+// Evaluate tile (work group) primitive list: pTI[pTS[t]] .. pTI[pTS[t+1]-1]
+// staged through local memory
+const char primBinnedSrc[]=
+"#define PRIM_CHUNK 256\n" \
+"kernel void image (__global int *pI, const ushort2 def, __global const float8 *pP, __global const int *pTS, __global const int *pTI)\n" \
+"{ __local float8 lP[PRIM_CHUNK];\n" \
+"  const int t= get_group_id(1) * get_num_groups(0) + get_group_id(0);\n" \
+"  const int l= get_local_id(1) * get_local_size(0) + get_local_id(0);\n" \
+"  const int nl= get_local_size(0) * get_local_size(1);\n" \
+"  const int i1= pTS[t+1];\n" \
+"  ushort2 u;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  const float2 p= (float2)(u.x, u.y);\n" \
+"  float s= MAXFLOAT;\n" \
+"  for (int i= pTS[t]; i < i1; i+= PRIM_CHUNK)\n" \
+"  { const int n= min(PRIM_CHUNK, i1 - i);\n" \
+"    barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"    for (int j= l; j < n; j+= nl) { lP[j]= pP[pTI[i+j]]; }\n" \
+"    barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"    for (int j=0; j<n; j++) { s= fmin(s, sdPrim(p, lP[j])); }\n" \
+"  }\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) { pI[(size_t)u.y * def.x + u.x]= convert_int_sat(s); } }\n";
+
+
+/***/
+
+enum PrimType { PT_CIRCLE, PT_SEGMENT, PT_BOX };
+
+// Host mirror of kernel float8 primitive
+struct DMapPrim
+{
+   cl_float v[8];
+
+   static DMapPrim circle (float x, float y, float r) { return DMapPrim(PT_CIRCLE,x,y,0,0,r); }
+   static DMapPrim segment (float ax, float ay, float bx, float by, float r=0) { return DMapPrim(PT_SEGMENT,ax,ay,bx,by,r); }
+   static DMapPrim box (float cx, float cy, float hx, float hy, float r=0) { return DMapPrim(PT_BOX,cx,cy,hx,hy,r); }
+
+   DMapPrim (int t=PT_CIRCLE, float x0=0, float y0=0, float x1=0, float y1=0, float r=0)
+   {
+      v[0]= x0; v[1]= y0; v[2]= x1; v[3]= y1; v[4]= r; v[5]= t; v[6]= v[7]= 0;
+   }
+
+   // Host equivalent of kernel sdPrim()
+   float sd (float px, float py) const
+   {
+      switch((int)v[5])
+      {
+         case PT_CIRCLE : return(hypotf(px - v[0], py - v[1]) - v[4]);
+         case PT_SEGMENT :
+         {
+            float pax= px - v[0], pay= py - v[1], bax= v[2] - v[0], bay= v[3] - v[1];
+            float h= std::min(1.0f, std::max(0.0f, (pax * bax + pay * bay) / (bax * bax + bay * bay)));
+            return(hypotf(pax - bax * h, pay - bay * h) - v[4]);
+         }
+         case PT_BOX :
+         {
+            float dx= fabsf(px - v[0]) - v[2], dy= fabsf(py - v[1]) - v[3];
+            return(hypotf(std::max(dx,0.0f), std::max(dy,0.0f)) + std::min(std::max(dx,dy), 0.0f) - v[4]);
+         }
+      }
+      return(HUGE_VALF);
+   } // sd
+
+   // Axis aligned bounding box (x0,y0,x1,y1)
+   void bounds (float b[4]) const
+   {
+      switch((int)v[5])
+      {
+         case PT_CIRCLE :
+            b[0]= v[0] - v[4]; b[1]= v[1] - v[4]; b[2]= v[0] + v[4]; b[3]= v[1] + v[4];
+            break;
+         case PT_SEGMENT :
+            b[0]= std::min(v[0],v[2]) - v[4]; b[1]= std::min(v[1],v[3]) - v[4];
+            b[2]= std::max(v[0],v[2]) + v[4]; b[3]= std::max(v[1],v[3]) + v[4];
+            break;
+         default :
+            b[0]= v[0] - v[2] - v[4]; b[1]= v[1] - v[3] - v[4];
+            b[2]= v[0] + v[2] + v[4]; b[3]= v[1] + v[3] + v[4];
+            break;
+      }
+   } // bounds
+}; // DMapPrim
+
+// Compressed (start index) list per cell of a 2D grid
+struct CellLists
+{
+   int *pS, *pI; // start[nC+1], index[pS[nC]]
+   int nX, nY;
+
+   CellLists (void) : pS{NULL}, pI{NULL}, nX{0}, nY{0} { ; }
+   ~CellLists () { release(); }
+
+   int nCells (void) const { return(nX * nY); }
+   int nEntries (void) const { return(pS ? pS[nCells()] : 0); }
+
+   bool release (void)
+   {
+      if (pS) { delete [] pS; pS= NULL; }
+      if (pI) { delete [] pI; pI= NULL; }
+      return(true);
+   } // release
+
+   // Begin construction: counts accumulated in pS[1..nC] by caller
+   void setup (int x, int y)
+   {
+      release();
+      nX= x; nY= y;
+      pS= new int[nCells()+1];
+      for (int i=0; i<=nCells(); i++) { pS[i]= 0; }
+   } // setup
+
+   void count (int c) { pS[c+1]++; }
+
+   // Convert counts to start indices (prefix sum) and allocate index table
+   void commitCounts (void)
+   {
+      for (int i=0; i<nCells(); i++) { pS[i+1]+= pS[i]; }
+      pI= new int[std::max(1,nEntries())];
+   } // commitCounts
+}; // CellLists
+
+class CPrimBins
+{
+protected:
+   CellLists   grid;    // primitives by bounding box overlap
+   int         *pStamp; // last tile visit, per primitive
+   int         *pCand;  // candidates for current tile
+   float       *pSDC;   // distance at tile centre, per candidate
+
+   void binBounds (const DMapPrim p[], const int n)
+   {
+      for (int pass=0; pass<2; pass++)
+      {
+         int *pW= NULL;
+         if (pass > 0)
+         {
+            grid.commitCounts();
+            pW= new int[grid.nCells()];
+            for (int c=0; c<grid.nCells(); c++) { pW[c]= grid.pS[c]; }
+         }
+         for (int i=0; i<n; i++)
+         {
+            float b[4];
+            int c[4];
+            p[i].bounds(b);
+            c[0]= clampCell(b[0] / tile, grid.nX); c[1]= clampCell(b[1] / tile, grid.nY);
+            c[2]= clampCell(b[2] / tile, grid.nX); c[3]= clampCell(b[3] / tile, grid.nY);
+            for (int y= c[1]; y <= c[3]; y++)
+            {
+               for (int x= c[0]; x <= c[2]; x++)
+               {
+                  const int k= y * grid.nX + x;
+                  if (pW) { grid.pI[ pW[k]++ ]= i; } else { grid.count(k); }
+               }
+            }
+         }
+         if (pW) { delete [] pW; }
+      }
+   } // binBounds
+
+   static int clampCell (float f, int n) { return(std::max(0, std::min(n-1, (int)floorf(f)))); }
+
+   // Gather candidates for tile (tx,ty) from rings of grid cells, return count
+   int gather (const DMapPrim p[], const int tx, const int ty, const int t, float& ub)
+   {
+      const float cx= tx * tile + 0.5 * (tile-1), cy= ty * tile + 0.5 * (tile-1);
+      const float h= M_SQRT1_2 * (tile-1);
+      const int maxK= std::max(grid.nX, grid.nY);
+      int nC= 0;
+
+      ub= HUGE_VALF;
+      for (int k=0; k <= maxK; k++)
+      {
+         for (int y= ty-k; y <= ty+k; y++)
+         {
+            if ((y < 0) || (y >= grid.nY)) { continue; }
+            const int dx= ((y == ty-k) || (y == ty+k)) ? 1 : 2*k; // full row or ring sides
+            for (int x= tx-k; x <= tx+k; x+= std::max(1,dx))
+            {
+               if ((x < 0) || (x >= grid.nX)) { continue; }
+               const int c= y * grid.nX + x;
+               for (int j= grid.pS[c]; j < grid.pS[c+1]; j++)
+               {
+                  const int i= grid.pI[j];
+                  if (pStamp[i] != t)
+                  {
+                     pStamp[i]= t;
+                     pSDC[nC]= p[i].sd(cx,cy);
+                     ub= std::min(ub, pSDC[nC] + h);
+                     pCand[nC++]= i;
+                  }
+               }
+            }
+         }
+         if ((k * tile) >= ub) { break; } // unvisited primitives lie further than bound
+      }
+      // cull those which cannot be nearest anywhere in tile
+      int m= 0;
+      for (int j=0; j<nC; j++)
+      {
+         if ((pSDC[j] - h) <= ub) { pCand[m++]= pCand[j]; }
+      }
+      return(m);
+   } // gather
+
+public:
+   CellLists   tiles;   // per tile primitive index lists
+   int         tile;
+
+   CPrimBins (int t=PRIM_TILE) : pStamp{NULL}, pCand{NULL}, pSDC{NULL}, tile{t} { ; }
+   ~CPrimBins () { release(); }
+
+   // Build per tile lists for <n> primitives over map of definition <def>, returns list entries
+   int bin (const DMapPrim p[], const int n, const Def2D& def)
+   {
+      const int nX= (def.x + tile - 1) / tile, nY= (def.y + tile - 1) / tile;
+      int *pN;
+
+      release();
+      grid.setup(nX, nY);
+      binBounds(p, n);
+      pStamp= new int[std::max(1,n)];
+      pCand= new int[std::max(1,n)];
+      pSDC= new float[std::max(1,n)];
+      for (int i=0; i<n; i++) { pStamp[i]= -1; }
+
+      // two passes: count then fill (candidate lists recomputed rather than stored)
+      tiles.setup(nX, nY);
+      pN= new int[tiles.nCells()];
+      for (int pass=0; pass<2; pass++)
+      {
+         if (pass > 0) { tiles.commitCounts(); for (int i=0; i<n; i++) { pStamp[i]= -1; } }
+         for (int ty=0; ty<nY; ty++)
+         {
+            for (int tx=0; tx<nX; tx++)
+            {
+               const int t= ty * nX + tx;
+               float ub;
+               if (0 == pass) { pN[t]= gather(p, tx, ty, t, ub); tiles.pS[t+1]= pN[t]; }
+               else
+               {
+                  gather(p, tx, ty, t, ub);
+                  for (int j=0; j<pN[t]; j++) { tiles.pI[ tiles.pS[t] + j ]= pCand[j]; }
+               }
+            }
+         }
+      }
+      delete [] pN;
+      return(tiles.nEntries());
+   } // bin
+
+   bool release (void)
+   {
+      if (pStamp) { delete [] pStamp; pStamp= NULL; }
+      if (pCand) { delete [] pCand; pCand= NULL; }
+      if (pSDC) { delete [] pSDC; pSDC= NULL; }
+      return(grid.release() && tiles.release());
+   } // release
+}; // CPrimBins
+
+// Device resident primitive list (and bins) as kernel arguments
+class PrimMapArgs : public GeomArgs
+{
+public:
+   cl_mem   hP, hTS, hTI;
+   cl_int   nP;
+   bool     binned;
+
+   PrimMapArgs (void) : hP{0}, hTS{0}, hTI{0}, nP{0}, binned{false} { ; }
+   ~PrimMapArgs () { release(); }
+
+   // Upload primitives, plus tile lists when <pB> is given
+   bool upload (cl_context ctx, const DMapPrim p[], const int n, const CPrimBins *pB=NULL)
+   {
+      cl_int r[3]={0,0,0};
+      release();
+      nP= n;
+      hP= clCreateBuffer(ctx, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, std::max(1,n) * sizeof(*p), (void*)p, r+0);
+      binned= (NULL != pB);
+      if (binned)
+      {
+         const CellLists& t= pB->tiles;
+         hTS= clCreateBuffer(ctx, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, (t.nCells()+1) * sizeof(*t.pS), t.pS, r+1);
+         hTI= clCreateBuffer(ctx, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, std::max(1,t.nEntries()) * sizeof(*t.pI), t.pI, r+2);
+      }
+      return((r[0] >= 0) && (r[1] >= 0) && (r[2] >= 0));
+   } // upload
+
+   uint8_t nArgs (void) const override { return(binned ? 3 : 2); }
+
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   {
+      switch(i)
+      {
+         case 0 : bytes= sizeof(hP); return(&hP);
+         case 1 :
+            if (binned) { bytes= sizeof(hTS); return(&hTS); }
+            bytes= sizeof(nP); return(&nP);
+         case 2 : if (binned) { bytes= sizeof(hTI); return(&hTI); }
+         default : bytes= 0; return(NULL);
+      }
+   } // get
+
+   bool release (void)
+   {
+      cl_int r=0;
+      if (0 != hP) { r|= clReleaseMemObject(hP); hP= 0; }
+      if (0 != hTS) { r|= clReleaseMemObject(hTS); hTS= 0; }
+      if (0 != hTI) { r|= clReleaseMemObject(hTI); hTI= 0; }
+      return(r >= 0);
+   } // release
+}; // PrimMapArgs
+
+#endif // PRIM_MAP_OCL_HPP
@@ -0,0 +1,166 @@
+// ProfileOCL.hpp - Per work group load instrumentation of map image kernels.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// OpenCL C offers no portable clock, so load is measured as a work count
+// (e.g. iterations) reported by each work item. Kernels are instrumented by
+// building with one of the source prefixes below and using the macros:
+//    kernel void image (__global int *pI, const ushort2 def, ... WG_PROFILE_ARG)
+//    { WG_BEGIN ... if (inside) { ... WG_COUNT(n); } WG_END }
+// giving the sum & maximum over each work group in a side buffer, appended to
+// the kernel arguments by WGProfileArgs. Without instrumentation the macros
+// are empty so the same kernel source serves both builds.
+
+#ifndef PROFILE_OCL_HPP
+#define PROFILE_OCL_HPP
+
+#include <cmath>
+
+#include "MapImageOCL.hpp"
+
+
+/* OpenCL kernel source prefixes */
+
+const char wgProfileSrc[]=
+"#define WG_PROFILE_ARG , __global uint *pW\n" \
+"#define WG_BEGIN __local uint wgSum, wgMax; const int wgL= get_local_id(0) + get_local_id(1);\\\n" \
+"  if (0 == wgL) { wgSum= 0; wgMax= 0; } barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"#define WG_COUNT(n) { atomic_add(&wgSum, (uint)(n)); atomic_max(&wgMax, (uint)(n)); }\n" \
+"#define WG_END barrier(CLK_LOCAL_MEM_FENCE);\\\n" \
+"  if (0 == wgL) { size_t g= 2 * (get_group_id(1) * get_num_groups(0) + get_group_id(0)); pW[g]= wgSum; pW[g+1]= wgMax; }\n\n";
+
+const char wgNoProfileSrc[]=
+"#define WG_PROFILE_ARG\n" \
+"#define WG_BEGIN\n" \
+"#define WG_COUNT(n)\n" \
+"#define WG_END\n\n";
+
+
+/***/
+
+// Summary of load over work groups
+struct WGStats
+{
+   float mean, max, cv;   // of group sums, cv= coefficient of variation
+   float imbalance;       // max / mean: time of slowest group relative to average
+   float efficiency;      // mean over groups of sum / (max * items): lockstep (SIMD) utilisation
+}; // WGStats
+
+// Appends profile buffer to the arguments of any map kernel
+class WGProfileArgs : public GeomArgs
+{
+public:
+   const GeomArgs *pA;
+   cl_mem         hW;
+
+   WGProfileArgs (const GeomArgs *pBase=NULL, cl_mem h=0) : pA{pBase}, hW{h} { ; }
+
+   uint8_t nArgs (void) const override { return(pA->nArgs() + 1); }
+
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   {
+      if (i < pA->nArgs()) { return pA->get(bytes, i, pR, pD); }
+      bytes= sizeof(hW);
+      return(&hW);
+   } // get
+}; // WGProfileArgs
+
+class CWorkGroupProfile
+{
+protected:
+   cl_mem   hW;
+   size_t   bytes;
+
+public:
+   cl_uint  *pW;        // (sum, max) per group
+   size_t   ng[2];      // groups on each axis
+   size_t   lws[2];
+
+   CWorkGroupProfile (void) : hW{0}, bytes{0}, pW{NULL} { ng[0]= ng[1]= lws[0]= lws[1]= 0; }
+   ~CWorkGroupProfile () { release(); }
+
+   size_t numGroups (void) const { return(ng[0] * ng[1]); }
+
+   // Buffer for map definition and local work size
+   bool create (cl_context ctx, const Def2D& def, const size_t l[2])
+   {
+      cl_int r;
+      release();
+      for (int d=0; d<2; d++) { lws[d]= l[d]; ng[d]= (def.s[d] + l[d] - 1) / l[d]; }
+      bytes= 2 * numGroups() * sizeof(*pW);
+      pW= new cl_uint[2 * numGroups()];
+      hW= clCreateBuffer(ctx, CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY, bytes, NULL, &r);
+      return(r >= 0);
+   } // create
+
+   WGProfileArgs args (const GeomArgs& a) const { return WGProfileArgs(&a, hW); }
+
+   bool read (cl_command_queue q)
+   {
+      return(clEnqueueReadBuffer(q, hW, CL_BLOCKING, 0, bytes, pW, 0, NULL, NULL) >= 0);
+   } // read
+
+   // Items per group are counted within the map (edge groups may be partial)
+   WGStats stats (const Def2D& def) const
+   {
+      WGStats s={0,0,0,0,0};
+      const size_t n= numGroups();
+      double sum=0, sum2=0, eff=0;
+      for (size_t gy=0; gy < ng[1]; gy++)
+      {
+         const size_t h= std::min(lws[1], def.y - gy * lws[1]);
+         for (size_t gx=0; gx < ng[0]; gx++)
+         {
+            const size_t w= std::min(lws[0], def.x - gx * lws[0]), g= 2 * (gy * ng[0] + gx);
+            const double v= pW[g];
+            sum+= v; sum2+= v * v;
+            s.max= std::max<float>(s.max, v);
+            if (pW[g+1] > 0) { eff+= v / ((double)pW[g+1] * w * h); }
+         }
+      }
+      if (n > 0)
+      {
+         s.mean= sum / n;
+         if (s.mean > 0)
+         {
+            s.cv= sqrt(std::max<double>(0, sum2 / n - s.mean * s.mean)) / s.mean;
+            s.imbalance= s.max / s.mean;
+         }
+         s.efficiency= eff / n;
+      }
+      return(s);
+   } // stats
+
+   // Heatmap of group sums (0..255 relative to maximum) at map definition, so
+   // it may be overlaid on the map image. Save with CMapImage2D::save(name,1)
+   bool heatmap (CMapImage2D& m, const Def2D& def) const
+   {
+      cl_uint mx= 1;
+      for (size_t g=0; g < numGroups(); g++) { mx= std::max(mx, pW[2*g]); }
+      if (m.numElem() != (size_t)def.x * def.y)
+      {
+         m.release();
+         if (0 == m.allocate(def.x, def.y)) { return(false); }
+      }
+      for (size_t y=0; y < def.y; y++)
+      {
+         for (size_t x=0; x < def.x; x++)
+         {
+            const size_t g= (y / lws[1]) * ng[0] + (x / lws[0]);
+            m.pI[y * def.x + x]= (255 * (uint64_t)pW[2*g]) / mx;
+         }
+      }
+      return(true);
+   } // heatmap
+
+   bool release (void)
+   {
+      cl_int r=0;
+      if (0 != hW) { r= clReleaseMemObject(hW); hW= 0; }
+      if (pW) { delete [] pW; pW= NULL; }
+      return(r >= 0);
+   } // release
+}; // CWorkGroupProfile
+
+#endif // PROFILE_OCL_HPP
@@ -9,6 +9,9 @@
 #ifndef QUERY_OCL_HPP
 #define QUERY_OCL_HPP
 
+#include <cstring>
+#include "DeviceOCL.hpp"
+
 
 // Function-encapsulation "functor" base class
 class InfoFunc
@@ -112,6 +115,10 @@ int queryDevPfm (cl_device_id idDev[], int maxD, cl_platform_id idPfm[], int max
                st.setup();
                addStr(st, DevInfo(idDev[iD]), ditok, 4);
                std::cout << "\t" << st[0] << " (" << st[1] << ") " << st[2] << " (Driver V" << st[3] << ")" << std::endl;
+               const DeviceProfile& dp= deviceProfile(idDev[iD]);
+               std::cout << "\t\tCU=" << dp.computeUnits << " WG=" << dp.maxWG << " local=" << (dp.localMem >> 10) << "k";
+               std::cout << " global=" << (dp.globalMem >> 20) << "M maxAlloc=" << (dp.maxAlloc >> 20) << "M";
+               std::cout << " vecF=" << dp.vecFloat << " fp16=" << dp.fp16 << " fp64=" << dp.fp64 << std::endl;
             }
             nDev+= n;
          }
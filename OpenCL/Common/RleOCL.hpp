@@ -0,0 +1,168 @@
+// RleOCL.hpp - Device side run-length compression of map images.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Each row of the (device resident) map is encoded as runs of equal elements
+// (MapRun: value, start x). One work group per row counts run starts, a
+// single group scans the counts into row offsets (total last), then each row
+// group scans the counts of its work items to place runs in order. Only the
+// total and the runs are transferred: rows are delimited by runs at x=0 and
+// CMapImage2D::decode() / loadRuns() restore the map. A map that would not
+// shrink is not transferred, compress() returns 0 and the caller reads the
+// raw map instead. Elements are read through MAP_IDX (any layout), image
+// maps (CMapImageOCL::createImage()) are not supported.
+
+#ifndef RLE_OCL_HPP
+#define RLE_OCL_HPP
+
+#include <vector>
+
+#include "MapImageOCL.hpp"
+
+#define RLE_LOCAL_MAX   256   // work group size
+
+
+/* OpenCL kernel source */
+
+const char rleSrc[]=
+"#define RLE_LOCAL_MAX 256\n" \
+"int runStart (__global const int *pI, const int x, const int y, const ushort2 def)\n" \
+"{ return((0 == x) || (pI[MAP_IDX(x,y,def)] != pI[MAP_IDX(x-1,y,def)])); }\n" \
+"\n" \
+"// Exclusive scan over work group (total in s[n-1] on return)\n" \
+"int groupScan (__local int *s, const int v)\n" \
+"{ const int l= get_local_id(0), n= get_local_size(0);\n" \
+"  s[l]= v;\n" \
+"  barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"  for (int d=1; d<n; d<<= 1) {\n" \
+"    const int t= (l >= d) ? s[l-d] : 0;\n" \
+"    barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"    s[l]+= t;\n" \
+"    barrier(CLK_LOCAL_MEM_FENCE); }\n" \
+"  return(s[l] - v); }\n" \
+"\n" \
+"kernel void rowRuns (__global int *pC, __global const int *pI, const ushort2 def)\n" \
+"{ __local int s[RLE_LOCAL_MAX];\n" \
+"  const int y= get_group_id(0), l= get_local_id(0), n= get_local_size(0);\n" \
+"  int c= 0;\n" \
+"  for (int x= l; x < def.x; x+= n) { c+= runStart(pI, x, y, def); }\n" \
+"  groupScan(s, c);\n" \
+"  if (0 == l) { pC[y]= s[n-1]; } }\n" \
+"\n" \
+"kernel void rowOffsets (__global int *pC, const int h)\n" \
+"{ __local int s[RLE_LOCAL_MAX];\n" \
+"  const int l= get_local_id(0), n= get_local_size(0);\n" \
+"  int base= 0;\n" \
+"  for (int y0= 0; y0 < h; y0+= n) {\n" \
+"    const int y= y0 + l, c= (y < h) ? pC[y] : 0;\n" \
+"    const int e= groupScan(s, c);\n" \
+"    if (y < h) { pC[y]= base + e; }\n" \
+"    base+= s[n-1];\n" \
+"    barrier(CLK_LOCAL_MEM_FENCE); }\n" \
+"  if (0 == l) { pC[h]= base; } }\n" \
+"\n" \
+"// Each work item encodes a contiguous section of the row, so runs are written in order\n" \
+"kernel void rowWrite (__global int2 *pR, __global const int *pC, __global const int *pI, const ushort2 def, const int maxRun)\n" \
+"{ __local int s[RLE_LOCAL_MAX];\n" \
+"  const int y= get_group_id(0), l= get_local_id(0), n= get_local_size(0);\n" \
+"  const int w= (def.x + n - 1) / n, x0= min(l * w, (int)def.x), x1= min(x0 + w, (int)def.x);\n" \
+"  int c= 0;\n" \
+"  for (int x= x0; x < x1; x++) { c+= runStart(pI, x, y, def); }\n" \
+"  int o= pC[y] + groupScan(s, c);\n" \
+"  for (int x= x0; x < x1; x++) {\n" \
+"    if (runStart(pI, x, y, def)) { if (o < maxRun) { pR[o]= (int2)(pI[MAP_IDX(x,y,def)], x); } ++o; } } }\n";
+
+
+/***/
+
+class CMapRLE
+{
+protected:
+   cl_program  idProg;
+   cl_kernel   kC, kO, kW;
+   cl_mem      hC, hR;  // row counts/offsets (+total), runs
+   cl_int      maxRun;  // runs no larger than the raw map
+   size_t      lws;
+
+public:
+   Def2D    def;
+   std::vector<MapRun> runs; // of last compress()
+   size_t   nRun;            // total runs of last compress(), transferred or not
+
+   CMapRLE (void) : idProg{0}, kC{0}, kO{0}, kW{0}, hC{0}, hR{0}, maxRun{0}, lws{RLE_LOCAL_MAX}, nRun{0} { def.x= def.y= 0; }
+   ~CMapRLE () { release(); }
+
+   // Build kernels & buffers in context of map (work group size fitted to device)
+   bool create (CMapImageOCL& m)
+   {
+      cl_int r;
+      char pre[2048];
+      const char *src[2]= { pre, rleSrc };
+
+      release();
+      if (m.isImage()) { return(false); }
+      mapLayoutSrc(pre, sizeof(pre), m.getHost());
+      def= m.getHost().def;
+      lws= RLE_LOCAL_MAX;
+      if (m.dp.maxWG > 0) { while (lws > m.dp.maxWG) { lws>>= 1; } }
+      maxRun= m.getHost().numElem() * sizeof(MapElement) / sizeof(MapRun);
+      hC= clCreateBuffer(m.ctx, CL_MEM_READ_WRITE, (def.y + 1) * sizeof(cl_int), NULL, &r);
+      if (r >= 0) { hR= clCreateBuffer(m.ctx, CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY, std::max<size_t>(1, maxRun) * sizeof(MapRun), NULL, &r); }
+      if (r >= 0) { idProg= clCreateProgramWithSource(m.ctx, 2, src, NULL, &r); }
+      if (r >= 0) { r= clBuildProgram(idProg, 0, NULL, NULL, NULL, NULL); }
+      if (r >= 0) { kC= clCreateKernel(idProg, "rowRuns", &r); }
+      if (r >= 0) { kO= clCreateKernel(idProg, "rowOffsets", &r); }
+      if (r >= 0) { kW= clCreateKernel(idProg, "rowWrite", &r); }
+      return(r >= 0);
+   } // create
+
+   // Encode device map, transferring runs to runs[] if smaller than the map.
+   // Returns number of runs transferred, 0 if none (incompressible or failure)
+   size_t compress (CMapImageOCL& m)
+   {
+      cl_mem hI= m.getDeviceMap();
+      const cl_int h= def.y;
+      const size_t gws= def.y * lws;
+      cl_int r, total= 0;
+
+      nRun= 0;
+      r= clSetKernelArg(kC, 0, sizeof(hC), &hC);
+      r|= clSetKernelArg(kC, 1, sizeof(hI), &hI);
+      r|= clSetKernelArg(kC, 2, sizeof(def), &def);
+      r|= clSetKernelArg(kO, 0, sizeof(hC), &hC);
+      r|= clSetKernelArg(kO, 1, sizeof(h), &h);
+      r|= clSetKernelArg(kW, 0, sizeof(hR), &hR);
+      r|= clSetKernelArg(kW, 1, sizeof(hC), &hC);
+      r|= clSetKernelArg(kW, 2, sizeof(hI), &hI);
+      r|= clSetKernelArg(kW, 3, sizeof(def), &def);
+      r|= clSetKernelArg(kW, 4, sizeof(maxRun), &maxRun);
+      if (r >= 0) { r= clEnqueueNDRangeKernel(m.q, kC, 1, NULL, &gws, &lws, 0, NULL, NULL); }
+      if (r >= 0) { r= clEnqueueNDRangeKernel(m.q, kO, 1, NULL, &lws, &lws, 0, NULL, NULL); }
+      if (r >= 0) { r= clEnqueueNDRangeKernel(m.q, kW, 1, NULL, &gws, &lws, 0, NULL, NULL); }
+      if (r >= 0) { r= clEnqueueReadBuffer(m.q, hC, CL_BLOCKING, def.y * sizeof(cl_int), sizeof(total), &total, 0, NULL, NULL); }
+      if ((r < 0) || (total <= 0)) { return(0); }
+      nRun= total;
+      if (total >= maxRun) { return(0); } // no smaller than raw
+      runs.resize(total);
+      r= clEnqueueReadBuffer(m.q, hR, CL_BLOCKING, 0, total * sizeof(MapRun), runs.data(), 0, NULL, NULL);
+      return((r >= 0) ? total : 0);
+   } // compress
+
+   // Raw map size over compressed (runs) size, from last compress()
+   double ratio (void) const { return(nRun ? ((double)def.x * def.y * sizeof(MapElement)) / (nRun * sizeof(MapRun)) : 0); }
+
+   bool release (void)
+   {
+      if (0 != kC) { clReleaseKernel(kC); kC= 0; }
+      if (0 != kO) { clReleaseKernel(kO); kO= 0; }
+      if (0 != kW) { clReleaseKernel(kW); kW= 0; }
+      if (0 != idProg) { clReleaseProgram(idProg); idProg= 0; }
+      if (0 != hC) { clReleaseMemObject(hC); hC= 0; }
+      if (0 != hR) { clReleaseMemObject(hR); hR= 0; }
+      runs.clear(); nRun= 0;
+      return(true);
+   } // release
+}; // CMapRLE
+
+#endif // RLE_OCL_HPP
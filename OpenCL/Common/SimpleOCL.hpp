@@ -16,6 +16,11 @@
 // or just give the more specific name in the Makefile...
 
 #include <CL/cl.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include "DeviceOCL.hpp"
 
 // Minimal information required to use a device
 class CSimpleOCL
@@ -23,8 +28,9 @@ class CSimpleOCL
 public:
    cl_context        ctx;
    cl_command_queue  q;
+   DeviceProfile     dp;   // limits of context device
 //idDev{0},
-   CSimpleOCL (cl_device_id id=0) : ctx{0},q{0} { if (0 != id) { create(id); } }
+   CSimpleOCL (cl_device_id id=0) : ctx{0},q{0},dp{} { if (0 != id) { create(id); } }
 
    ~CSimpleOCL () { release(); }
 
@@ -37,6 +43,7 @@ public:
          if (r >= 0)
          {
             //idDev= id;
+            dp= deviceProfile(id);
 #ifdef OPENCL_LIB_200 // OpenCL 2.0+ on NVidia / Ubuntu despite requesting V1.2 ...
             q= clCreateCommandQueueWithProperties(ctx, id, NULL, &r);
 #else
@@ -81,37 +88,221 @@ public:
    }
 }; // CSimpleOCL
 
-// Build a simple kernel
+// Program build on a worker thread. clBuildProgram is commonly synchronous even
+// when given a notify callback, so a thread is used to overlap compilation with
+// host setup (or with other builds). Sources are copied before start() returns.
+struct BuildJob
+{
+   cl_program  p;
+   cl_int      r;    // build status, valid after wait()
+   std::thread t;
+
+   BuildJob (void) : p{0}, r{0} { ; }
+   ~BuildJob () { wait(); }
+
+   bool start (cl_context ctx, const char *srcTab[], const int nSrc, const char options[]=NULL)
+   {
+      wait();
+      p= clCreateProgramWithSource(ctx, nSrc, srcTab, NULL, &r);
+      if (r < 0) { return(false); }
+      const std::string opt= options ? options : "";
+      t= std::thread([this, opt](){ r= clBuildProgram(p, 0, NULL, opt.c_str(), NULL, NULL); });
+      return(true);
+   } // start
+
+   bool pending (void) const { return t.joinable(); }
+
+   cl_int wait (void)
+   {
+      if (t.joinable()) { t.join(); }
+      return(r);
+   } // wait
+}; // BuildJob
+
+// Maximum kernels held by registry of each program
+#define KERN_REG_MAX 16
+// Longest kernel name (including terminator) a registry accepts
+#define KERN_NAME_MAX 64
+
+// Named kernel of a program: handle (and the argument state set on it) persists between launches
+struct KernEntry
+{
+   char        name[KERN_NAME_MAX];
+   cl_kernel   k;
+   cl_uint     nArgs;
+}; // KernEntry
+
+// Kernels of one program by name. Names that do not fit are refused rather
+// than truncated (a truncated entry would never match a later lookup).
+class CKernelRegOCL
+{
+protected:
+   KernEntry   reg[KERN_REG_MAX];
+   int         nReg;
+
+   cl_kernel add (cl_kernel k, const char name[])
+   {
+      if ((nReg >= KERN_REG_MAX) || (strlen(name) >= KERN_NAME_MAX)) { clReleaseKernel(k); return(0); }
+      KernEntry& e= reg[nReg++];
+      strcpy(e.name, name);
+      e.k= k;
+      e.nArgs= 0;
+      clGetKernelInfo(k, CL_KERNEL_NUM_ARGS, sizeof(e.nArgs), &(e.nArgs), NULL);
+      return(k);
+   } // add
+
+public:
+   CKernelRegOCL (void) : nReg{0} { ; }
+   ~CKernelRegOCL () { release(); }
+
+   // Registered kernel, else 0
+   cl_kernel find (const char name[]) const
+   {
+      const int i= kernelIndex(name);
+      return((i > 0) ? reg[i-1].k : 0);
+   } // find
+
+   // Registered kernel of program p, created on first request (0 on failure)
+   cl_kernel kernel (cl_program p, const char name[])
+   {
+      cl_int r;
+      cl_kernel k= find(name);
+      if ((0 != k) || (0 == p) || (strlen(name) >= KERN_NAME_MAX)) { return(k); }
+      k= clCreateKernel(p, name, &r);
+      return((r >= 0) ? add(k, name) : 0);
+   } // kernel
+
+   // Register all kernels of program p, returning count
+   int registerAll (cl_program p)
+   {
+      cl_kernel k[KERN_REG_MAX];
+      cl_uint n= 0;
+      if ((0 != p) && (clCreateKernelsInProgram(p, KERN_REG_MAX, k, &n) >= 0))
+      {
+         for (cl_uint i=0; i<n; i++)
+         {
+            char name[KERN_NAME_MAX]={0,};
+            size_t b= 0;
+            if ((clGetKernelInfo(k[i], CL_KERNEL_FUNCTION_NAME, sizeof(name), name, &b) < 0) || (b > sizeof(name)))
+            { clReleaseKernel(k[i]); } // name too long
+            else if (0 != kernelIndex(name)) { clReleaseKernel(k[i]); } // already registered
+            else { add(k[i], name); }
+         }
+      }
+      return(nReg);
+   } // registerAll
+
+   // Registry index+1 of named kernel, or 0 if absent
+   int kernelIndex (const char name[]) const
+   {
+      for (int i=0; i<nReg; i++) { if (0 == strcmp(name, reg[i].name)) { return(i+1); } }
+      return(0);
+   } // kernelIndex
+
+   const KernEntry *entry (int i) const { return(((i >= 0) && (i < nReg)) ? reg+i : NULL); }
+
+   int count (void) const { return(nReg); }
+
+   bool release (void)
+   {
+      cl_int r=0;
+      for (int i=0; i<nReg; i++) { r|= clReleaseKernel(reg[i].k); }
+      nReg= 0;
+      return(r >= 0);
+   } // release
+}; // CKernelRegOCL
+
+// Build a program (source set) once, exposing any number of its kernels by name
 class CBuildOCL : public CSimpleOCL
 {
+protected:
+   CKernelRegOCL  kreg;
+   BuildJob       job;  // asynchronous build of idProg
+
 public:
    cl_program idProg;
-   cl_kernel  idKern;
+   cl_kernel  idKern;   // selected (default) kernel, owned by registry
+   uint32_t   buildSeq; // incremented by each build: kernel handles of earlier builds are stale
 
-   CBuildOCL (cl_device_id id=0) : idProg{0},idKern{0},CSimpleOCL(id) { ; }
+   CBuildOCL (cl_device_id id=0) : CSimpleOCL(id),idProg{0},idKern{0},buildSeq{0} { ; }
    ~CBuildOCL () { release(true); }
 
-   // Wrapper (overload) for single source
-   bool defaultBuild (const char src[], const char entryPoint[]) { return defaultBuild(&src, 1, entryPoint); }
-
-   bool defaultBuild (const char *srcTab[], const int nSrc, const char entryPoint[])
+   // Build program without creating any kernel
+   bool build (const char *srcTab[], const int nSrc)
    {
       cl_int r;
+      release(false); // discard any previous build
+      buildSeq++;
       idProg= clCreateProgramWithSource(ctx, nSrc, srcTab, NULL, &r);
       //std::cout << "clCreateProgramWithSource() - r=%d" << r);
       if (r >= 0)
       {  // simple build for default device
          r= clBuildProgram(idProg, 0, NULL, NULL, NULL, NULL);
          //std::cout << "clBuildProgram() - r=%d" << r);
-         if (r >= 0)
-         {  // Create the compute kernel in the program we wish to run
-            idKern= clCreateKernel(idProg, entryPoint, &r);
-            //std::cout << "clCreateKernel() - r=%d" << r);
-         }
       }
       return(r >= 0);
+   } // build
+
+   // Start building program, returning at once so host setup may proceed; complete
+   // with finish(). Kernel requests (kernel(), select()) wait for the build.
+   bool buildAsync (const char *srcTab[], const int nSrc, const char options[]=NULL)
+   {
+      release(false);
+      buildSeq++;
+      if (!job.start(ctx, srcTab, nSrc, options)) { return(false); }
+      idProg= job.p;
+      return(true);
+   } // buildAsync
+
+   bool buildAsync (const char src[]) { return buildAsync(&src, 1); }
+
+   // Wait for asynchronous build, then select entry point (if given)
+   bool finish (const char entryPoint[]=NULL)
+   {
+      if (job.wait() < 0) { return(false); }
+      return((NULL == entryPoint) || select(entryPoint));
+   } // finish
+
+   // Take ownership of a program built elsewhere (e.g. CBuildSetOCL) in this context
+   void adopt (cl_program p)
+   {
+      release(false);
+      buildSeq++;
+      idProg= p;
+   } // adopt
+
+   // Wrapper (overload) for single source
+   bool defaultBuild (const char src[], const char entryPoint[]) { return defaultBuild(&src, 1, entryPoint); }
+
+   bool defaultBuild (const char *srcTab[], const int nSrc, const char entryPoint[])
+   {
+      return(build(srcTab, nSrc) && select(entryPoint));
    } // defaultBuild
 
+   // Registered kernel of current program, created on first request (0 on failure)
+   cl_kernel kernel (const char name[])
+   {
+      cl_kernel k= kreg.find(name);
+      if ((0 != k) || (0 == idProg) || (job.wait() < 0)) { return(k); }
+      return kreg.kernel(idProg, name);
+   } // kernel
+
+   // Register all kernels of program, returning count
+   int registerAll (void) { return(((0 != idProg) && (job.wait() >= 0)) ? kreg.registerAll(idProg) : kreg.count()); }
+
+   // Registry index+1 of named kernel, or 0 if absent
+   int kernelIndex (const char name[]) const { return kreg.kernelIndex(name); }
+
+   const KernEntry *entry (int i) const { return kreg.entry(i); }
+
+   // Make named kernel the default (e.g. for CMapImageOCL::execute)
+   bool select (const char name[])
+   {
+      cl_kernel k= kernel(name);
+      if (0 != k) { idKern= k; }
+      return(0 != k);
+   } // select
+
    size_t getBuildLog (char log[], size_t max)
    {
       size_t n=0;
@@ -139,13 +330,12 @@ public:
 
    bool release (bool all=true) // override
    {
-      cl_int r;
+      cl_int r=0;
 
-      if (0 != idKern)
-      {//std::cout << "clReleaseKernel()" << std::endl;
-         r= clReleaseKernel(idKern);
-         idKern= 0;
-      }
+      job.wait();
+      job.r= 0;
+      if (!kreg.release()) { r= -1; }
+      idKern= 0;
       if (0 != idProg)
       {//std::cout << "clReleaseProgram()" << std::endl;
          r= clReleaseProgram(idProg);
@@ -158,4 +348,75 @@ public:
 
 }; // CBuildOCL
 
+// Maximum programs of a build set
+#define BUILD_SET_MAX 16
+
+// Programs (e.g. variants of one source by options "-D ...") built concurrently
+// in one context, each on its own worker thread
+class CBuildSetOCL
+{
+protected:
+   BuildJob job[BUILD_SET_MAX];
+   int      n;
+
+public:
+   CBuildSetOCL (void) : n{0} { ; }
+   ~CBuildSetOCL () { release(); }
+
+   // Start build, returning index or -1
+   int start (cl_context ctx, const char *srcTab[], const int nSrc, const char options[]=NULL)
+   {
+      if ((n >= BUILD_SET_MAX) || !job[n].start(ctx, srcTab, nSrc, options)) { return(-1); }
+      return(n++);
+   } // start
+
+   int count (void) const { return(n); }
+
+   // Wait for build i only, returning status
+   cl_int wait (int i) { return(((i >= 0) && (i < n)) ? job[i].wait() : -1); }
+
+   // Build log of program i for device <id> (e.g. of a failed build, still held by the set)
+   size_t getBuildLog (int i, cl_device_id id, char log[], size_t max)
+   {
+      size_t b=0;
+      if ((i < 0) || (i >= n) || (0 == job[i].p) || (0 == id)) { return(0); }
+      job[i].wait();
+      if (clGetProgramBuildInfo(job[i].p, id, CL_PROGRAM_BUILD_LOG, max, log, &b) < 0) { return(0); }
+      return(b);
+   } // getBuildLog
+
+   void reportBuildLog (int i, cl_device_id id)
+   {
+      size_t maxLog= 1<<12; // 4k
+      char *log= new char[maxLog];
+      if (log && (getBuildLog(i, id, log, maxLog) > 1))
+      {
+         std::cout << "Build Log (" << i << "):" << std::endl;
+         std::cout << log << std::endl;
+      }
+      delete [] log;
+   } // reportBuildLog
+
+   // Built program i, ownership passed to caller (e.g. CBuildOCL::adopt), else 0
+   cl_program take (int i)
+   {
+      if (wait(i) < 0) { return(0); }
+      cl_program p= job[i].p;
+      job[i].p= 0;
+      return(p);
+   } // take
+
+   bool release (void)
+   {
+      cl_int r= 0;
+      for (int i=0; i<n; i++)
+      {
+         job[i].wait();
+         if (0 != job[i].p) { r|= clReleaseProgram(job[i].p); job[i].p= 0; }
+      }
+      n= 0;
+      return(r >= 0);
+   } // release
+}; // CBuildSetOCL
+
 #endif // SIMPLE_OCL_HPP
@@ -0,0 +1,247 @@
+// StencilOCL.hpp - Neighbourhood (stencil) operations on device resident map images.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Stencil operators are given as a fragment of OpenCL C (function body) that
+// reads neighbours through the macro P(i,j), with offsets up to radius R.
+// For each stage of a chain, kernel source is generated from the fragment in
+// two forms: "tiled" - each work group loads its tile plus halo into local
+// memory once - and "naive" - every neighbour read from global memory - for
+// comparison. Stages ping-pong between device buffers, the input map buffer
+// is preserved and only the final result need be read back. Stage kernels
+// ("tiled<i>", "naive<i>") are held by a registry of the chain program,
+// separate from that of the map program. Elements are
+// addressed through MAP_IDX so any map layout (CMapImage2D::setLayout) serves.
+// Maps created as images (createImage()) are read through samplers: boundary
+// modes become sampler addressing modes, handled by texture hardware.
+
+#ifndef STENCIL_OCL_HPP
+#define STENCIL_OCL_HPP
+
+#include <cstdio>
+
+#include "MapImageOCL.hpp"
+
+#define STENCIL_STAGE_MAX  (KERN_REG_MAX / 2) // tiled & naive kernel per stage
+
+// Treatment of neighbours outside map
+enum BoundaryMode { BM_CLAMP, BM_ZERO, BM_WRAP, BM_MIRROR };
+
+struct StencilOp
+{
+   const char *name, *body;
+}; // StencilOp
+
+// Some useful operators
+const StencilOp stBlur= { "blur",
+   "int s=0; for (int j=-R; j<=R; j++) { for (int i=-R; i<=R; i++) { s+= P(i,j); } } return(s / ((2*R+1)*(2*R+1)));" };
+const StencilOp stGradient= { "gradient", // Sobel magnitude, sample spacing R
+   "int gx= P(R,-R) + 2*P(R,0) + P(R,R) - P(-R,-R) - 2*P(-R,0) - P(-R,R);" \
+   "int gy= P(-R,R) + 2*P(0,R) + P(R,R) - P(-R,-R) - 2*P(0,-R) - P(R,-R);" \
+   "return convert_int_rte(hypot((float)gx, (float)gy));" };
+const StencilOp stEdge= { "edge", // Laplacian
+   "return(P(R,0) + P(-R,0) + P(0,R) + P(0,-R) - 4 * P(0,0));" };
+const StencilOp stDilate= { "dilate", // disc structuring element
+   "int m= P(0,0); for (int j=-R; j<=R; j++) { for (int i=-R; i<=R; i++) { if ((i*i + j*j) <= R*R) { m= max(m, P(i,j)); } } } return(m);" };
+const StencilOp stErode= { "erode",
+   "int m= P(0,0); for (int j=-R; j<=R; j++) { for (int i=-R; i<=R; i++) { if ((i*i + j*j) <= R*R) { m= min(m, P(i,j)); } } } return(m);" };
+
+struct StencilStage
+{
+   const StencilOp   *pOp;
+   int               r;
+   BoundaryMode      bm;
+}; // StencilStage
+
+
+/* OpenCL kernel sources */
+
+const char stencilFetchSrc[]=
+"int fetch (MAP_IN pS, int x, int y, const ushort2 def, const int bm)\n" \
+"{ const int w= def.x, h= def.y;\n" \
+"  if ((x < 0) || (x >= w) || (y < 0) || (y >= h)) {\n" \
+"    switch(bm) {\n" \
+"      case 1 : return(0);\n" \
+"      case 2 : x= ((x % w) + w) % w; y= ((y % h) + h) % h; break;\n" \
+"      case 3 : x= (x < 0) ? -x-1 : ((x >= w) ? 2*w-x-1 : x); y= (y < 0) ? -y-1 : ((y >= h) ? 2*h-y-1 : y); // then clamp (R > def)\n" \
+"      default : x= clamp(x, 0, w-1); y= clamp(y, 0, h-1); break; } }\n" \
+"  return(pS[MAP_IDX(x,y,def)]); }\n\n";
+
+// Image map: wrap & mirror addressing require normalised coordinates
+const char stencilSampleSrc[]=
+"const sampler_t smpClamp= CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;\n" \
+"const sampler_t smpZero= CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP | CLK_FILTER_NEAREST;\n" \
+"const sampler_t smpWrap= CLK_NORMALIZED_COORDS_TRUE | CLK_ADDRESS_REPEAT | CLK_FILTER_NEAREST;\n" \
+"const sampler_t smpMirror= CLK_NORMALIZED_COORDS_TRUE | CLK_ADDRESS_MIRRORED_REPEAT | CLK_FILTER_NEAREST;\n" \
+"int fetch (MAP_IN pS, int x, int y, const ushort2 def, const int bm)\n" \
+"{ const float2 n= ((float2)(x, y) + 0.5f) / convert_float2(def);\n" \
+"  switch(bm) {\n" \
+"    case 1 : return read_imagei(pS, smpZero, (int2)(x,y)).x;\n" \
+"    case 2 : return read_imagei(pS, smpWrap, n).x;\n" \
+"    case 3 : return read_imagei(pS, smpMirror, n).x;\n" \
+"    default : return read_imagei(pS, smpClamp, (int2)(x,y)).x; } }\n\n";
+
+// Per stage template, parameters: stage (%1$d), radius, boundary mode, tile width, height, operator body
+const char stencilStageFmt[]=
+"#define R %2$d\n" \
+"#define TW %4$d\n" \
+"#define TH %5$d\n" \
+"#define LW (TW + 2*R)\n" \
+"#define LH (TH + 2*R)\n" \
+"#define P(i,j) t[(cy+(j)) * LW + cx+(i)]\n" \
+"int opT%1$d (__local const int *t, const int cx, const int cy) { %6$s }\n" \
+"#undef P\n" \
+"#define P(i,j) fetch(pS, cx+(i), cy+(j), def, %3$d)\n" \
+"int opG%1$d (MAP_IN pS, const int cx, const int cy, const ushort2 def) { %6$s }\n" \
+"#undef P\n" \
+"\n" \
+"kernel void tiled%1$d (MAP_OUT pD, MAP_IN pS, const ushort2 def)\n" \
+"{ __local int t[LH * LW];\n" \
+"  const int lx= get_local_id(0), ly= get_local_id(1);\n" \
+"  const int x0= get_group_id(0) * TW - R, y0= get_group_id(1) * TH - R;\n" \
+"  for (int j= ly; j < LH; j+= TH) { for (int i= lx; i < LW; i+= TW) { t[j * LW + i]= fetch(pS, x0+i, y0+j, def, %3$d); } }\n" \
+"  barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"  const int x= get_global_id(0), y= get_global_id(1);\n" \
+"  if ((x < def.x) && (y < def.y)) { MAP_STORE(pD, x, y, def, opT%1$d(t, lx + R, ly + R)); } }\n" \
+"\n" \
+"kernel void naive%1$d (MAP_OUT pD, MAP_IN pS, const ushort2 def)\n" \
+"{ const int x= get_global_id(0), y= get_global_id(1);\n" \
+"  if ((x < def.x) && (y < def.y)) { MAP_STORE(pD, x, y, def, opG%1$d(pS, x, y, def)); } }\n" \
+"#undef R\n#undef TW\n#undef TH\n#undef LW\n#undef LH\n\n";
+
+
+/***/
+
+// Map image with a chain of stencil stages applied on the device
+class CStencilMapOCL : public CMapImageOCL
+{
+protected:
+   cl_program     idStProg;
+   CKernelRegOCL  stReg;   // stage kernels of idStProg
+   cl_mem         hT[2];   // ping-pong
+   int            nStage, iR;
+   size_t         tile[2];
+
+   cl_kernel stageKernel (bool tiled, int i) const
+   {
+      char name[16];
+      snprintf(name, sizeof(name), "%s%d", tiled ? "tiled" : "naive", i);
+      return stReg.find(name);
+   } // stageKernel
+
+public:
+   CStencilMapOCL (void) : idStProg{0}, hT{0,0}, nStage{0}, iR{-1}
+   {
+      tile[0]= tile[1]= 16;
+   }
+   ~CStencilMapOCL () { release(); }
+
+   // Ping-pong buffers (or images) matching map
+   bool createTemp (void)
+   {
+      cl_int r[2];
+      hT[0]= device.createLike(r+0);
+      hT[1]= device.createLike(r+1);
+      return((r[0] >= 0) && (r[1] >= 0));
+   } // createTemp
+
+   // Stencils read the map buffer so it must be readable on device
+   bool createArgs (size_t w, size_t h)
+   {
+      return(CMapImageOCL::createArgs(w, h, CL_MEM_READ_WRITE|CL_MEM_HOST_READ_ONLY) && createTemp());
+   } // createArgs
+
+   // Map values (CL_R, 32bit signed) as image, stages read by sampler
+   bool createImage (size_t w, size_t h)
+   {
+      return(CMapImageOCL::createImage(w, h, CL_R, CL_SIGNED_INT32, CL_MEM_READ_WRITE|CL_MEM_HOST_READ_ONLY) && createTemp());
+   } // createImage
+
+   // Generate and build kernels for chain of <n> stages, tile size is (local) work group size
+   bool buildChain (const StencilStage s[], const int n, const size_t lws[2])
+   {
+      const int maxSrc= 1<<14;
+      char *pSrc= new char[maxSrc];
+      int l= 0;
+      cl_int r=-1;
+
+      releaseChain();
+      nStage= std::min(n, STENCIL_STAGE_MAX);
+      tile[0]= lws[0]; tile[1]= lws[1];
+      l= mapLayoutSrc(pSrc, maxSrc, host, device.isImage()); // map elements addressed by MAP_IDX
+      l+= snprintf(pSrc+l, maxSrc-l, "%s", device.isImage() ? stencilSampleSrc : stencilFetchSrc);
+      for (int i=0; (i < nStage) && (l < maxSrc); i++)
+      {
+         l+= snprintf(pSrc+l, maxSrc-l, stencilStageFmt, i, s[i].r, s[i].bm, (int)tile[0], (int)tile[1], s[i].pOp->body);
+      }
+      if (l < maxSrc)
+      {
+         const char *src= pSrc;
+         idStProg= clCreateProgramWithSource(ctx, 1, &src, NULL, &r);
+         if (r >= 0) { r= clBuildProgram(idStProg, 0, NULL, NULL, NULL, NULL); }
+         if ((r >= 0) && (stReg.registerAll(idStProg) < 2 * nStage)) { r= -1; }
+      }
+      delete [] pSrc;
+      return(r >= 0);
+   } // buildChain
+
+   // Apply chain to (device) map, result held on device. Per stage timing in pDT[]
+   bool applyChain (bool tiled, TimeValF *pDT=NULL)
+   {
+      size_t gws[2];
+      cl_int r=0;
+      cl_mem hS= device.hI;
+
+      host.setGWS(gws, tile);
+      elapsed();
+      for (int i=0; (r >= 0) && (i < nStage); i++)
+      {
+         cl_kernel k= stageKernel(tiled, i);
+         iR= i & 1;
+         clSetKernelArg(k, 0, sizeof(hT[iR]), hT+iR);
+         clSetKernelArg(k, 1, sizeof(hS), &hS);
+         clSetKernelArg(k, 2, sizeof(host.def), &(host.def));
+         r= clEnqueueNDRangeKernel(q, k, 2, NULL, gws, tile, 0, NULL, NULL);
+         hS= hT[iR];
+         if (pDT) { clFinish(q); pDT[i]= elapsed(); }
+      }
+      clFinish(q);
+      return(r >= 0);
+   } // applyChain
+
+   // Transfer chain result to host map
+   bool readChain (void)
+   {
+      if (iR < 0) { return(false); }
+      return(device.read(q, host.pI, hT[iR]) >= 0);
+   } // readChain
+
+   bool releaseChain (void)
+   {
+      stReg.release();
+      if (0 != idStProg) { clReleaseProgram(idStProg); idStProg= 0; }
+      nStage= 0; iR= -1;
+      return(true);
+   } // releaseChain
+
+   void reportChainLog (void)
+   {
+      size_t n= 0, maxLog= 1<<12;
+      char *log= new char[maxLog];
+      if (log && (clGetProgramBuildInfo(idStProg, getDevice(), CL_PROGRAM_BUILD_LOG, maxLog, log, &n) >= 0) && (n > 1))
+      {
+         std::cout << "Stencil Build Log:" << std::endl << log << std::endl;
+      }
+      delete [] log;
+   } // reportChainLog
+
+   bool release (bool all=true)
+   {
+      releaseChain();
+      for (int i=0; i<2; i++) { if (0 != hT[i]) { clReleaseMemObject(hT[i]); hT[i]= 0; } }
+      return CMapImageOCL::release(all);
+   } // release
+}; // CStencilMapOCL
+
+#endif // STENCIL_OCL_HPP
@@ -0,0 +1,145 @@
+// TileCache.hpp - LRU cache of fixed size map tiles with optional disk spill.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Tiles are identified by (view, level, x, y) packed into a 64bit key. The
+// most recently used tiles are held in memory, least recently used evicted
+// when capacity is reached. If a spill directory is given, evicted tiles are
+// written there as raw MapElement files (named by key) and recovered on a
+// later memory miss.
+
+#ifndef TILE_CACHE_HPP
+#define TILE_CACHE_HPP
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#include "MapImage.hpp"
+
+struct TileKey
+{
+   int32_t view, level, x, y;
+
+   // view & level 8bits each, coordinates 24bits each (level <= 24)
+   uint64_t pack (void) const
+   {
+      return(((uint64_t)(view & 0xFF) << 56) | ((uint64_t)(level & 0xFF) << 48) |
+             ((uint64_t)(y & 0xFFFFFF) << 24) | (uint64_t)(x & 0xFFFFFF));
+   } // pack
+}; // TileKey
+
+struct TileCacheStats
+{
+   size_t hits, diskHits, misses, evictions, spills;
+
+   TileCacheStats (void) : hits{0}, diskHits{0}, misses{0}, evictions{0}, spills{0} { ; }
+
+   size_t lookups (void) const { return(hits + diskHits + misses); }
+   float hitRate (void) const { size_t n= lookups(); return(n > 0 ? (float)(hits + diskHits) / n : 0); }
+}; // TileCacheStats
+
+class CTileCache
+{
+protected:
+   struct Entry
+   {
+      uint64_t key;
+      std::vector<MapElement> v;
+   }; // Entry
+
+   std::list<Entry> lru; // front is most recent
+   std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+   std::unordered_set<uint64_t> onDisk; // tiles already spilled (unchanged once rendered)
+   size_t   maxTiles, tileElem;
+   const char *spillDir;
+
+   void spillPath (char path[], const size_t max, const uint64_t key) const
+   {
+      snprintf(path, max, "%s/t%016llx.raw", spillDir, (unsigned long long)key);
+   } // spillPath
+
+   bool spill (const Entry& e)
+   {
+      char path[256];
+      if (onDisk.count(e.key) > 0) { return(false); }
+      spillPath(path, sizeof(path), e.key);
+      auto outFile= std::fstream(path, std::ios::out | std::ios::binary);
+      if (outFile.is_open())
+      {
+         outFile.write((const char *)e.v.data(), tileElem * sizeof(MapElement));
+         outFile.close();
+         onDisk.insert(e.key);
+         return(true);
+      }
+      return(false);
+   } // spill
+
+   bool recover (MapElement t[], const uint64_t key) const
+   {
+      char path[256];
+      if (0 == onDisk.count(key)) { return(false); } // avoid stale files of a previous run
+      spillPath(path, sizeof(path), key);
+      auto inFile= std::fstream(path, std::ios::in | std::ios::binary);
+      if (inFile.is_open())
+      {
+         inFile.read((char *)t, tileElem * sizeof(MapElement));
+         return(inFile.gcount() == (std::streamsize)(tileElem * sizeof(MapElement)));
+      }
+      return(false);
+   } // recover
+
+public:
+   TileCacheStats stats;
+
+   CTileCache (size_t nTiles=256, size_t nElem=128*128, const char *dir=NULL) : maxTiles{nTiles}, tileElem{nElem}, spillDir{dir} { ; }
+
+   size_t tileBytes (void) const { return(tileElem * sizeof(MapElement)); }
+   size_t size (void) const { return(lru.size()); }
+
+   // Copy tile to t[] if present (memory or disk), updating recency
+   bool get (MapElement t[], const TileKey& k)
+   {
+      const uint64_t key= k.pack();
+      auto i= index.find(key);
+      if (index.end() != i)
+      {
+         lru.splice(lru.begin(), lru, i->second);
+         memcpy(t, i->second->v.data(), tileBytes());
+         stats.hits++;
+         return(true);
+      }
+      if (spillDir && recover(t, key))
+      {
+         put(k, t);
+         stats.diskHits++;
+         return(true);
+      }
+      stats.misses++;
+      return(false);
+   } // get
+
+   void put (const TileKey& k, const MapElement t[])
+   {
+      const uint64_t key= k.pack();
+      auto i= index.find(key);
+      if (index.end() != i) { lru.splice(lru.begin(), lru, i->second); return; }
+      if (lru.size() >= maxTiles)
+      {  // evict least recent
+         Entry& e= lru.back();
+         if (spillDir && spill(e)) { stats.spills++; }
+         index.erase(e.key);
+         lru.pop_back();
+         stats.evictions++;
+      }
+      lru.push_front(Entry{key, std::vector<MapElement>(t, t + tileElem)});
+      index[key]= lru.begin();
+   } // put
+}; // CTileCache
+
+#endif // TILE_CACHE_HPP
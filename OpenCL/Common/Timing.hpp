@@ -54,12 +54,21 @@ public:
 
 #endif
 
+// Companion measurement taken at every interval boundary (e.g. CEnergyMeter)
+class CIntervalSink
+{
+public:
+   virtual ~CIntervalSink () { ; }
+   virtual void interval (TimeValF now) = 0;
+}; // CIntervalSink
+
 class CElapsedTime : public CTimestamp
 {
 public:
    TimeValF last;
+   CIntervalSink *pSink; // optional, adds its sampling cost to intervals
 
-   CElapsedTime (void) { last= get(); }
+   CElapsedTime (void) : pSink{NULL} { last= get(); }
 
    TimeValF elapsed (void)
    {
@@ -67,6 +76,7 @@ public:
       TimeValF now= get();
       if ((last > 0) && (now > last)) { diff= now - last; }
       last= now;
+      if (pSink) { pSink->interval(now); }
       return(diff);
    } // elapsed
 
@@ -0,0 +1,298 @@
+// WorkloadOCL.hpp - Benchmark workloads behind a common interface, registered by name for a runtime driven benchmark.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// A workload keeps its context and built program between setup() calls, so a
+// sweep over sizes and work group shapes only reallocates buffers. Everything
+// that the test programs fix at compile time (definition, view, iteration
+// limit, local work size, read back) is given by WorkOpt instead.
+
+#ifndef WORKLOAD_OCL_HPP
+#define WORKLOAD_OCL_HPP
+
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+#include "SimpleOCL.hpp"
+#include "MapImageOCL.hpp"
+#include "KernSrcOCL.hpp"
+#include "MapGeomOCL.hpp"
+
+struct WorkOpt
+{
+   Def2D    def;        // map definition (vector length def.x * def.y)
+   Scalar   view[3];    // Mandelbrot: centre & half width. Distance: circle centre & radius, fractions of map width
+   bool     viewSet;    // otherwise default view of each workload
+   int      iter;       // iteration limit
+   size_t   lws[2];     // local work size (1D workloads use the product)
+   bool     readBack;   // time includes result transfer to host
+
+   WorkOpt (void) : def{512,512}, view{0,0,0}, viewSet{false}, iter{256}, lws{16,16}, readBack{false} { ; }
+}; // WorkOpt
+
+// Abstract base class
+class CWorkload
+{
+public:
+   const char *name;
+   size_t      lwsRun[2];  // local work size launched by last run(), may differ from options
+
+   CWorkload (const char *n) : name{n}, lwsRun{0,0} { ; }
+   virtual ~CWorkload () { ; }
+
+   // Prepare on device for options: context & program created once, buffers as needed
+   virtual bool setup (cl_device_id id, const WorkOpt& o) = 0;
+
+   // One repetition complete on return, time in t (kernel, plus read back if set)
+   virtual bool run (const WorkOpt& o, TimeValF& t) = 0;
+
+   // Work of one repetition: elements computed and global memory traffic
+   virtual double items (const WorkOpt& o) const { return((double)o.def.x * o.def.y); }
+   virtual double bytes (const WorkOpt& o) const { return(items(o) * sizeof(MapElement)); }
+
+   virtual void release (void) = 0;
+}; // CWorkload
+
+class CWorkloadRegistry
+{
+protected:
+   std::vector<CWorkload*> w;
+
+public:
+   void add (CWorkload *p) { if (p) { w.push_back(p); } }
+
+   size_t size (void) const { return w.size(); }
+
+   CWorkload *operator[] (size_t i) const { return((i < w.size()) ? w[i] : NULL); }
+
+   // By name or unique prefix of name
+   CWorkload *find (const char name[]) const
+   {
+      CWorkload *p= NULL;
+      const size_t l= strlen(name);
+      for (CWorkload *c : w)
+      {
+         if (0 == strcmp(name, c->name)) { return(c); }
+         if (0 == strncmp(name, c->name, l)) { if (p) { return(NULL); } p= c; } // ambiguous
+      }
+      return(p);
+   } // find
+
+   void release (void) { for (CWorkload *c : w) { c->release(); } }
+}; // CWorkloadRegistry
+
+
+/* OpenCL kernel sources: shared (KernSrcOCL.hpp) except Mandelbrot entry point */
+
+// Iteration limit as argument, so no rebuild when it changes
+const char wlMandelSrc[]=
+"kernel void image (__global int *pI, const ushort2 def, const float2 c0, const float2 dc, const int maxI)\n" \
+"{ ushort2 u; float2 c;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    c.x= c0.x + dc.x * u.x;\n" \
+"    c.y= c0.y + dc.y * u.y;\n" \
+"    pI[(size_t)u.y * def.x + u.x]= mandel(&c, maxI, 1E12); } }\n";
+
+
+/***/
+
+// r= a + b over def.x * def.y elements
+class CVecAddWork : public CWorkload
+{
+protected:
+   CBuildOCL   ocl;
+   cl_mem      h[3];   // r, a, b
+   float       *pR;    // read back of r
+   cl_uint     n;
+   cl_device_id dev;
+
+   void releaseBuffers (void)
+   {
+      for (int i=0; i<3; i++) { if (0 != h[i]) { clReleaseMemObject(h[i]); h[i]= 0; } }
+      delete [] pR;
+      pR= NULL;
+      n= 0;
+   } // releaseBuffers
+
+public:
+   CVecAddWork (void) : CWorkload("vecadd"), h{0,0,0}, pR{NULL}, n{0}, dev{0} { ; }
+   ~CVecAddWork () { release(); }
+
+   bool setup (cl_device_id id, const WorkOpt& o) override
+   {
+      const cl_uint nE= (size_t)o.def.x * o.def.y;
+      cl_int r[3];
+
+      if (dev != id)
+      {
+         release();
+         if (!ocl.create(id) || !ocl.defaultBuild(vecAddSrc, "vecAdd")) { ocl.reportBuildLog(); return(false); }
+         dev= id;
+      }
+      if (n == nE) { return(true); }
+      releaseBuffers();
+      float *pH= new float[nE];
+      for (cl_uint i=0; i<nE; i++) { pH[i]= sinf(i * M_PI / (1<<8)) * sinf(i * M_PI / (1<<8)); }
+      h[0]= clCreateBuffer(ocl.ctx, CL_MEM_WRITE_ONLY, nE * sizeof(float), NULL, r+0);
+      h[1]= clCreateBuffer(ocl.ctx, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, nE * sizeof(float), pH, r+1);
+      h[2]= clCreateBuffer(ocl.ctx, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, nE * sizeof(float), pH, r+2);
+      delete [] pH;
+      if ((r[0] < 0) || (r[1] < 0) || (r[2] < 0)) { releaseBuffers(); return(false); }
+      pR= new float[nE];
+      n= nE;
+      return(true);
+   } // setup
+
+   bool run (const WorkOpt& o, TimeValF& t) override
+   {
+      const size_t l= std::max<size_t>(1, std::min<size_t>(o.lws[0] * o.lws[1], (ocl.dp.maxWG > 0) ? ocl.dp.maxWG : 256));
+      const size_t gws= ((n + l - 1) / l) * l;
+      CElapsedTime et;
+      cl_int r;
+
+      r= clSetKernelArg(ocl.idKern, 0, sizeof(h[0]), h+0);
+      r|= clSetKernelArg(ocl.idKern, 1, sizeof(h[1]), h+1);
+      r|= clSetKernelArg(ocl.idKern, 2, sizeof(h[2]), h+2);
+      r|= clSetKernelArg(ocl.idKern, 3, sizeof(n), &n);
+      et.elapsed();
+      if (r >= 0) { r= clEnqueueNDRangeKernel(ocl.q, ocl.idKern, 1, NULL, &gws, &l, 0, NULL, NULL); }
+      if (r >= 0) { r= clFinish(ocl.q); }
+      if ((r >= 0) && o.readBack) { r= clEnqueueReadBuffer(ocl.q, h[0], CL_BLOCKING, 0, n * sizeof(float), pR, 0, NULL, NULL); }
+      t= et.elapsed();
+      lwsRun[0]= l; lwsRun[1]= 1;
+      return(r >= 0);
+   } // run
+
+   double bytes (const WorkOpt& o) const override { return(items(o) * 3 * sizeof(float)); }
+
+   void release (void) override
+   {
+      releaseBuffers();
+      ocl.release(true);
+      dev= 0;
+   } // release
+}; // CVecAddWork
+
+// Map synthesis by CMapImageOCL, kernel "image" with geometry arguments from options
+class CMapWork : public CWorkload
+{
+protected:
+   CMapImageOCL   img;
+   const char     *src[2];
+   int            nSrc;
+   Def2D          cur;
+   cl_device_id   dev;
+
+   // Geometry arguments for options
+   virtual const GeomArgs& args (const WorkOpt& o) = 0;
+
+public:
+   // Kernel source s, optionally preceded by functions f
+   CMapWork (const char *n, const char *s, const char *f=NULL) : CWorkload(n), src{f,s}, nSrc{2}, cur{0,0}, dev{0}
+   {
+      if (NULL == f) { src[0]= s; nSrc= 1; }
+   } // CMapWork
+
+   bool setup (cl_device_id id, const WorkOpt& o) override
+   {
+      if (dev != id)
+      {
+         release();
+         if (!img.create(id)) { return(false); }
+         if (!img.defaultBuild(src, nSrc, "image")) { img.reportBuildLog(); return(false); }
+         dev= id;
+      }
+      if ((cur.x == o.def.x) && (cur.y == o.def.y)) { return(true); }
+      img.release(false); // keep context & program
+      cur.x= cur.y= 0;
+      if (!img.createArgs(o.def.x, o.def.y)) { return(false); }
+      cur= o.def;
+      return(true);
+   } // setup
+
+   bool run (const WorkOpt& o, TimeValF& t) override
+   {
+      size_t lws[2]= { o.lws[0], o.lws[1] };
+      TimeValF dt[3]={0,0,0};
+
+      img.fitLWS(lws);
+      img.elapsed();
+      if (!img.execute(lws, args(o), dt, o.readBack)) { return(false); }
+      lwsRun[0]= lws[0]; lwsRun[1]= lws[1];
+      t= dt[1] + dt[2]; // kernel & read (argument setting excluded)
+      return(true);
+   } // run
+
+   void release (void) override
+   {
+      img.release(true);
+      cur.x= cur.y= 0;
+      dev= 0;
+   } // release
+}; // CMapWork
+
+class CIndexWork : public CMapWork
+{
+protected:
+   EmptyGeomArgs ga;
+
+   const GeomArgs& args (const WorkOpt& o) override { return(ga); }
+
+public:
+   CIndexWork (void) : CMapWork("index", idxKernSrc) { ; }
+}; // CIndexWork
+
+class CDistanceWork : public CMapWork
+{
+protected:
+   DMapGeomArgs ga;
+
+   const GeomArgs& args (const WorkOpt& o) override
+   {
+      const Scalar d[3]= { 0.5, 0.5, 0.25 }; // centre & radius, fractions of map width
+      const Scalar *p= o.viewSet ? o.view : d;
+      for (int i=0; i<3; i++) { ga.v[i]= p[i] * o.def.x; }
+      return(ga);
+   } // args
+
+public:
+   CDistanceWork (void) : CMapWork("distance", dmapKernSrc), ga(0,0,0) { ; }
+}; // CDistanceWork
+
+class CMandelWork : public CMapWork
+{
+protected:
+   class MandelArgs : public MandelGeomArgs
+   {
+   public:
+      cl_int   maxI;
+
+      MandelArgs (void) : MandelGeomArgs(-0.75, 0, 1.5), maxI{256} { ; }
+
+      uint8_t nArgs (void) const override { return(3); }
+
+      const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+      {
+         if (2 == i) { bytes= sizeof(maxI); return(&maxI); }
+         return MandelGeomArgs::get(bytes, i, pR, pD);
+      } // get
+   } ga; // MandelArgs
+
+   const GeomArgs& args (const WorkOpt& o) override
+   {
+      const Scalar d[3]= { -0.75, 0, 1.5 };
+      const Scalar *p= o.viewSet ? o.view : d;
+      ga.v[0]= p[0] - p[2]; ga.v[1]= p[1] - p[2]; // lower bound
+      ga.v[2]= ga.v[3]= 2 * p[2];                 // width
+      ga.maxI= o.iter;
+      return(ga);
+   } // args
+
+public:
+   CMandelWork (void) : CMapWork("mandelbrot", wlMandelSrc, mandelFuncSrc) { ; }
+}; // CMandelWork
+
+#endif // WORKLOAD_OCL_HPP
@@ -9,6 +9,9 @@
 #include "Common/Timing.hpp"
 #include "Common/SimpleOCL.hpp"
 #include "Common/QueryOCL.hpp"
+#include "Common/Energy.hpp"
+#include "Common/HostSIMD.hpp"
+#include "Common/KernSrcOCL.hpp"
 
 
 /***/
@@ -30,11 +33,6 @@ void vecAdd (Scalar r[], const Scalar a[], const Scalar b[], const size_t n)
 
 /***/
 
-// OpenCL kernel source
-const char vecAddSrc[]=
-"kernel void vecAdd(__global float *pR, __global float *pA, __global float *pB, const size_t n)\n" \
-"{ int id= get_global_id(0); if (id < n) { pR[id]= pA[id] + pB[id]; } }";
-
 struct HostArgs
 {
    Scalar *pR, *pA, *pB;   // host memory buffers
@@ -105,9 +103,10 @@ struct DeviceArgs
 
 }; // DeviceArgs
 
-void initData (const HostArgs& h)
+// Initialise elements [i0,i1)
+void initData (const HostArgs& h, size_t i0, size_t i1)
 {
-   for (size_t i= 0; i < h.n; i++)
+   for (size_t i= i0; i < i1; i++)
    {
       double theta= i * M_PI / (1<<8);
       h.pA[i] = sinf(theta)*sinf(theta);
@@ -123,6 +122,8 @@ Scalar sum (const Scalar v[], const size_t n)
    return(s);
 } // sum
 
+CHostThreads gHostThreads; // tuned host baseline
+
 class CVecAddOCL : public CBuildOCL, public CElapsedTime
 {
 protected:
@@ -156,7 +157,8 @@ public:
       ar[0]= clSetKernelArg(CBuildOCL::idKern, 0, sizeof(device.hR), &(device.hR));
       ar[1]= clSetKernelArg(CBuildOCL::idKern, 1, sizeof(device.hA), &(device.hA));
       ar[2]= clSetKernelArg(CBuildOCL::idKern, 2, sizeof(device.hB), &(device.hB));
-      ar[3]= clSetKernelArg(CBuildOCL::idKern, 3, sizeof(host.n), &(host.n));
+      const cl_uint n= host.n; // size_t is not a valid kernel argument type
+      ar[3]= clSetKernelArg(CBuildOCL::idKern, 3, sizeof(n), &n);
       if (pDT) { pDT[0]= elapsed(); }
       //std::cout << "ar: %d %d %d %d" << ar[0], ar[1], ar[2], ar[3]);
 
@@ -171,7 +173,7 @@ public:
 
       if (r >= 0)
       {
-         std::cout << "kernel enqueued" << std::endl;
+         //std::cout << "kernel enqueued" << std::endl;
          clFinish(CSimpleOCL::q); // Global sync
          if (pDT) { pDT[2]= elapsed(); }
 
@@ -183,7 +185,11 @@ public:
       return(r >= 0);
    } // execute
 
-   void initHostData (void) { initData(host); }
+   // Initialise by partition on host threads: first touch places pages where the host baseline uses them
+   void initHostData (void)
+   {
+      gHostThreads.run([&](int i, int m){ size_t i0, i1; CHostThreads::part(i0, i1, host.n, i, m); initData(host, i0, i1); });
+   } // initHostData
 
    Scalar sumR (void) { return sum(host.pR, host.n); }
 
@@ -196,44 +202,102 @@ public:
       return(r);
    }
 
-   TimeValF hostTest (void)
+   // Host vecAdd & sum of result: serial scalar then threaded SIMD. Timing in pDT[]: add, add, sum, sum
+   void hostTest (TimeValF pDT[4], Scalar s[2])
    {
       elapsed();
       vecAdd(host.pR, host.pA, host.pB, host.n);
-      return elapsed();
+      pDT[0]= elapsed();
+      gHostThreads.add(host.pR, host.pA, host.pB, host.n);
+      pDT[1]= elapsed();
+      s[0]= sum(host.pR, host.n);
+      pDT[2]= elapsed();
+      s[1]= gHostThreads.sum(host.pR, host.n);
+      pDT[3]= elapsed();
    } // hostTest
 }; // CVecAddOCL
 
 
 /***/
 
+CEnergyMeter gEnergy;
+
+// Energy of phases in t[] (intervals from iE, build measured after data-init when
+// overlapped), then per frame over repeated frames (one add per element)
+void energy (CVecAddOCL& va, const TimeValF t[7], const uint32_t iE, const bool overlap)
+{
+   const char *phase[]= { "context", "build", "data-init", "args", "buffers-in", "kernel", "buffer-out" };
+   const int order[2][7]= { { 0, 1, 2, 3, 4, 5, 6 }, { 0, 2, 1, 3, 4, 5, 6 } };
+   const double flop= va.getN();
+   EnergyValF j;
+   TimeValF tf;
+
+   std::cout << "energy (" << gEnergy.name() << ", " << gEnergy.channels() << " channels):" << std::endl;
+   for (int i=0; i<7; i++) { energyReport(phase[i], gEnergy.joules(iE + order[overlap][i]), t[i], 1, (5 == i) ? flop : 0); }
+   va.pSink= NULL; // single sample over all frames
+   uint32_t n= energyFrames(gEnergy, [&](){ va.execute(32); }, j, tf);
+   energyReport("frames", j, tf, n, flop);
+   va.pSink= &gEnergy;
+} // energy
+
+// Phases in order of completion up to first kernel result, overlapped build waited on after setup
+void timeline (const TimeValF t[6], const bool overlap)
+{
+   const char *phase[]= { "context", overlap ? "build wait" : "build", "args+data-init", "kernel args", "buffers-in", "kernel" };
+   const int order[2][6]= { { 0, 1, 2, 3, 4, 5 }, { 0, 2, 1, 3, 4, 5 } };
+   TimeValF s= 0;
+
+   std::cout << "startup timeline (" << (overlap ? "overlapped" : "sequential") << " build):" << std::endl;
+   for (int i=0; i<6; i++)
+   {
+      const int k= order[overlap][i];
+      s+= t[k];
+      std::cout << "\t" << s << "sec\t" << phase[k] << std::endl;
+   }
+   std::cout << "time to first kernel: " << s << "sec" << std::endl;
+} // timeline
+
 int main (int argc, char *argv[])
 {
    cl_platform_id idPfm[MAX_PF_ID]={0,};
    cl_device_id   idDev[MAX_DEV_ID]={0,};
    cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   const bool     overlap= !((argc > 1) && (0 == strcmp(argv[1], "-s"))); // "-s" builds before setup
    int r=-1;
 
    if (nDev > 0)
    {
       CVecAddOCL va;
       TimeValF t[7];
+      uint32_t iE= 0;
+      bool built, args;
+
+      if (gEnergy.open()) { va.pSink= &gEnergy; iE= gEnergy.count(); }
 
-      if (va.create(idDev[0]) && va.createArgs(1<<20))
+      if (va.create(idDev[0]))
       {
          t[0]= va.elapsed();
          std::cout << "context created: " << t[0] << "sec" << std::endl;
-         if (va.defaultBuild(vecAddSrc,"vecAdd"))
+         if (overlap) { built= va.buildAsync(vecAddSrc); } // compile during setup
+         else
          {
+            built= va.defaultBuild(vecAddSrc,"vecAdd");
             t[1]= va.elapsed();
-            std::cout << "build OK: " << t[1] << "sec" << std::endl;
-
-            va.initHostData();
-
-            t[2]= va.elapsed();
+         }
+         args= built && va.createArgs(1<<20);
+         if (args) { va.initHostData(); }
+         t[2]= va.elapsed();
+         if (overlap)
+         {
+            built= built && va.finish("vecAdd");
+            t[1]= va.elapsed(); // remainder not hidden by setup
+         }
+         if (built)
+         {
+            std::cout << "build OK: " << t[1] << "sec" << (overlap ? " (wait after setup)" : "") << std::endl;
             std::cout << "Data init: " << t[2] << "sec" << std::endl;
 
-            if (va.execute(32, t+3))
+            if (args && va.execute(32, t+3))
             {
                std::cout << "execution:" << std::endl;
                std::cout << "\targs:       " << t[3] << "sec"  << std::endl;
@@ -247,7 +311,18 @@ int main (int argc, char *argv[])
                std::cout << "relative error=" << re << std::endl;
                if (re <= 1E-6) { r= 0; }
 
-               std::cout << "unaccelerated host: " << va.hostTest() << "sec"  << std::endl;
+               TimeValF th[4];
+               Scalar sh[2];
+               va.hostTest(th, sh);
+               std::cout << "vecAdd, device vs host:" << std::endl;
+               std::cout << "\tdevice kernel:  " << t[5] << "sec (with buffers " << t[4] + t[5] + t[6] << "sec)" << std::endl;
+               std::cout << "\thost serial:    " << th[0] << "sec" << std::endl;
+               std::cout << "\thost " << gHostThreads.n << "T " << HOST_SIMD_NAME << ":   " << th[1] << "sec" << std::endl;
+               std::cout << "sum (host):" << std::endl;
+               std::cout << "\tserial:         " << th[2] << "sec" << std::endl;
+               std::cout << "\t" << gHostThreads.n << "T " << HOST_SIMD_NAME << ":        " << th[3] << "sec, difference " << sh[1] - sh[0] << std::endl;
+               timeline(t, overlap);
+               if (gEnergy.valid()) { energy(va, t, iE, overlap); }
             }
          }
          else { va.reportBuildLog(); }
@@ -0,0 +1,132 @@
+// ocl10.cpp - Histogram equalised colouring of Mandelbrot iteration map on device.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <cmath>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/HistColourOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+#define MAX_ITER     256
+
+// Host equivalent of device passes, for verification & timing comparison
+class CHostEqualise
+{
+public:
+   cl_uint h[HIST_BINS];
+
+   int bin (const int v, const int v0, const int v1) const
+   {
+      return std::min(HIST_BINS-1, (int)((v - v0) * ((float)HIST_BINS / (v1 - v0))));
+   } // bin
+
+   void hist (const MapElement m[], const size_t n, const int v0, const int v1)
+   {
+      for (int i=0; i<HIST_BINS; i++) { h[i]= 0; }
+      for (size_t i=0; i<n; i++) { if ((m[i] >= v0) && (m[i] < v1)) { h[ bin(m[i], v0, v1) ]++; } }
+   } // hist
+
+   void colour (uint8_t rgba[], const MapElement m[], const size_t n, const int v0, const int v1) const
+   {
+      cl_uint c[HIST_BINS];
+      c[0]= h[0];
+      for (int i=1; i<HIST_BINS; i++) { c[i]= c[i-1] + h[i]; }
+      for (size_t i=0; i<n; i++)
+      {
+         uint8_t *p= rgba + 4 * i;
+         p[0]= p[1]= p[2]= 0; p[3]= 0xFF;
+         if ((m[i] >= v0) && (m[i] < v1))
+         {
+            const float t= (float)c[ bin(m[i], v0, v1) ] / c[HIST_BINS-1];
+            for (int j=0; j<3; j++) { p[j]= (uint8_t)(255 * (0.5f + 0.5f * cosf(6.2831853f * (t + 0.1f * j))) + 0.5f); }
+         }
+      }
+   } // colour
+}; // CHostEqualise
+
+
+/***/
+Def2D gDef={512,512};
+
+// Mandelbrot (ocl3) as source map
+const MandelGeomArgs mandelGA(Complex2D(-0.909, -0.275), Complex2D(0.3,0.3));
+
+CHistColourOCL img; // global to avoid segment violation
+CHostEqualise hostEq;
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      TimeValF t[5];
+      size_t lws[2]={16,16};
+
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      {
+         t[0]= img.elapsed();
+         std::cout << "context created: " << t[0] << "sec" << std::endl;
+
+         if (img.build(mandelKernSrc, "image") && img.execute(lws, mandelGA, t+1))
+         {  // Keep map for host comparison (interior, i.e. MAX_ITER, excluded)
+            const size_t n= img.getHost().numElem();
+            MapElement *pM= new MapElement[n];
+            uint8_t *pC= new uint8_t[4 * n];
+            cl_uint hD[HIST_BINS];
+            size_t mis= 0;
+            int maxDiff= 0;
+
+            memcpy(pM, img.getHost().pI, n * sizeof(*pM));
+            std::cout << "source map: " << t[2] << "sec" << std::endl;
+
+            img.execute(lws, mandelGA, t+1, false); // map left on device only
+            std::cout << "device (map only, no read): " << t[2] << "sec" << std::endl;
+            if (img.equalise(lws, 1, MAX_ITER, t))
+            {
+               std::cout << "device equalise:" << std::endl;
+               std::cout << "\thistogram:  " << t[0] << "sec" << std::endl;
+               std::cout << "\tcolour:     " << t[1] << "sec" << std::endl;
+               std::cout << "\tread:       " << t[2] << "sec" << std::endl;
+
+               img.elapsed();
+               hostEq.hist(pM, n, 1, MAX_ITER);
+               t[3]= img.elapsed();
+               hostEq.colour(pC, pM, n, 1, MAX_ITER);
+               t[4]= img.elapsed();
+               std::cout << "host equalise:" << std::endl;
+               std::cout << "\thistogram:  " << t[3] << "sec" << std::endl;
+               std::cout << "\tcolour:     " << t[4] << "sec" << std::endl;
+
+               img.readHist(hD);
+               for (int i=0; i<HIST_BINS; i++) { mis+= (hD[i] != hostEq.h[i]); }
+               std::cout << "histogram bin mismatch: " << mis << std::endl;
+               const uint8_t *pD= (const uint8_t*)(img.getHost().pI);
+               for (size_t i=0; i < 4*n; i++) { maxDiff= std::max(maxDiff, abs((int)pD[i] - (int)pC[i])); }
+               std::cout << "colour max difference: " << maxDiff << std::endl;
+               r= (0 == mis) ? 0 : -1;
+
+               img.save("img.raw", 0); // RGBA: convert -size 512x512 -depth 8 RGBA:img.raw img.png
+            }
+            delete [] pC;
+            delete [] pM;
+         }
+         else { img.reportBuildLog(); }
+      }
+   }
+   return(r);
+} // main
@@ -0,0 +1,524 @@
+// ocl11.cpp - Local tile render service: warm device context, LRU tile cache, batched launches.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Usage: ocl11 [serve|client|test] [socket path] [spill dir]
+// With no mode argument (or "test") a server process is forked and a test client session
+// (several concurrent connections panning over zoom levels) is run against it.
+// Evicted tiles are spilled to disk only when a spill directory is given.
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <cerrno>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+#include "Common/TileCache.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+#define TILE_DEF        128   // square tile edge (pixels)
+#define TILE_BATCH      16    // maximum tiles per kernel launch
+#define CACHE_TILES     64    // memory cache capacity
+#define MAX_CLIENT      16
+#define BATCH_WINDOW_MS 2     // wait for further requests before launching a partial batch
+#define NUM_CLIENT      4     // test session
+
+// Mandelbrot (ocl3) tiles stacked vertically in the map: tile t occupies rows [t*def.x, (t+1)*def.x)
+const char tileKernSrc[]=
+"void csq1 (float2 *pV) { float ty= 2 * pV->x * pV->y; pV->x= pV->x * pV->x - pV->y * pV->y; pV->y= ty; }\n\n" \
+"float csqad1m2 (float2 *pV, const float2 *pC) { csq1(pV); *pV+= *pC; return dot(*pV,*pV); }\n\n" \
+"\n" \
+"int mandel (const float2 *pC, int maxI, float maxM2)\n" \
+"{ int i=0; float2 x= *pC;\n" \
+"  do { ++i;} while ((csqad1m2(&x, pC) < maxM2) && (i < maxI));\n" \
+"  return(i); }\n" \
+"\n" \
+"kernel void image (__global int *pI, const ushort2 def, __global const float4 *pO, const int nT)\n" \
+"{ const int x= get_global_id(0), y= get_global_id(1), t= y / def.x;\n" \
+"  if ((x < def.x) && (y < def.y) && (t < nT)) {\n" \
+"    const float4 o= pO[t]; // origin (x,y) & resolution (z,w)\n" \
+"    float2 c= (float2)(o.x + o.z * x, o.y + o.w * (y - t * def.x));\n" \
+"    pI[(size_t)y * def.x + x]= mandel(&c, 256, 1E12); } }\n";
+
+// Level 0 of each view is a single tile, level L has 2^L x 2^L tiles
+struct TileView { Scalar cr, ci, sr; }; // centre & semi-radius
+const TileView tileView[]= { { -0.75, 0, 1.5 }, { -0.909, -0.275, 0.3 } };
+const int nTileView= sizeof(tileView) / sizeof(tileView[0]);
+
+// Wire protocol (host byte order, local only)
+enum TileOp { TO_TILE, TO_STATS, TO_QUIT };
+enum TileStatus { TS_OK, TS_CACHED, TS_INVALID, TS_FAIL };
+
+struct TileReq
+{
+   int32_t  op;
+   uint32_t id;   // echoed in response
+   TileKey  k;
+}; // TileReq
+
+struct TileResp
+{
+   int32_t  status;
+   uint32_t id, bytes; // payload follows
+}; // TileResp
+
+struct ServiceStats
+{
+   TileCacheStats cache;
+   size_t   requests, batches, rendered;
+   TimeValF renderSec, sumLatency, maxLatency; // latency: receipt to reply
+
+   ServiceStats (void) : requests{0}, batches{0}, rendered{0}, renderSec{0}, sumLatency{0}, maxLatency{0} { ; }
+}; // ServiceStats
+
+bool sendAll (int fd, const void *p, size_t n)
+{
+   const char *b= (const char*)p;
+   while (n > 0)
+   {
+      ssize_t r= send(fd, b, n, MSG_NOSIGNAL);
+      if (r <= 0) { return(false); }
+      b+= r; n-= r;
+   }
+   return(true);
+} // sendAll
+
+bool recvAll (int fd, void *p, size_t n)
+{
+   char *b= (char*)p;
+   while (n > 0)
+   {
+      ssize_t r= recv(fd, b, n, 0);
+      if (r <= 0) { return(false); }
+      b+= r; n-= r;
+   }
+   return(true);
+} // recvAll
+
+int openSocket (const char path[], bool server)
+{
+   struct sockaddr_un a;
+   int fd= socket(AF_UNIX, SOCK_STREAM, 0);
+
+   if (fd < 0) { return(-1); }
+   memset(&a, 0, sizeof(a));
+   a.sun_family= AF_UNIX;
+   strncpy(a.sun_path, path, sizeof(a.sun_path)-1);
+   if (server)
+   {
+      unlink(path);
+      if ((bind(fd, (struct sockaddr*)&a, sizeof(a)) >= 0) && (listen(fd, MAX_CLIENT) >= 0)) { return(fd); }
+   }
+   else if (connect(fd, (struct sockaddr*)&a, sizeof(a)) >= 0) { return(fd); }
+   close(fd);
+   return(-1);
+} // openSocket
+
+
+/***/
+
+class TileBatchArgs : public GeomArgs
+{
+public:
+   cl_mem   hO;
+   cl_int   n;
+
+   TileBatchArgs (void) : hO{0}, n{0} { ; }
+
+   uint8_t nArgs (void) const override { return(2); }
+
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   {
+      switch(i)
+      {
+         case 0 : bytes= sizeof(hO); return(&hO);
+         case 1 : bytes= sizeof(n); return(&n);
+         default : bytes= 0; return(NULL);
+      }
+   } // get
+}; // TileBatchArgs
+
+// Map holding a batch of tiles, context & program kept warm between requests
+class CTileRenderOCL : public CMapImageOCL
+{
+protected:
+   TileBatchArgs  ba;
+   size_t         tileDef, maxBatch;
+
+public:
+   CTileRenderOCL (void) : tileDef{0}, maxBatch{0} { ; }
+   ~CTileRenderOCL () { if (0 != ba.hO) { clReleaseMemObject(ba.hO); } }
+
+   bool createTiles (size_t t, size_t b)
+   {
+      cl_int r;
+      tileDef= t; maxBatch= b;
+      if (createArgs(t, t * b))
+      {
+         ba.hO= clCreateBuffer(ctx, CL_MEM_READ_ONLY, b * sizeof(cl_float4), NULL, &r);
+         return(r >= 0);
+      }
+      return(false);
+   } // createTiles
+
+   static bool valid (const TileKey& k)
+   {
+      return((k.view >= 0) && (k.view < nTileView) && (k.level >= 0) && (k.level <= 20) &&
+         (k.x >= 0) && (k.y >= 0) && (k.x < (1<<k.level)) && (k.y < (1<<k.level)));
+   } // valid
+
+   // Render up to maxBatch (valid) tiles in a single launch, results to pT[n][tileDef^2]
+   bool render (MapElement pT[], const TileKey k[], int n, size_t lws[2])
+   {
+      cl_float4 o[TILE_BATCH];
+      cl_int r;
+
+      n= std::min<int>(n, std::min(maxBatch, (size_t)TILE_BATCH));
+      for (int i=0; i<n; i++)
+      {
+         const TileView& v= tileView[ k[i].view ];
+         const Scalar w= 2 * v.sr / (1 << k[i].level);
+         o[i].s[0]= v.cr - v.sr + k[i].x * w;
+         o[i].s[1]= v.ci - v.sr + k[i].y * w;
+         o[i].s[2]= o[i].s[3]= w / tileDef;
+      }
+      ba.n= n;
+      r= clEnqueueWriteBuffer(q, ba.hO, CL_BLOCKING, 0, n * sizeof(o[0]), o, 0, NULL, NULL);
+      if (r >= 0) { r= setArgs(ba); }
+      if (r >= 0)
+      {  // launch over the rows of this batch only, not the whole map
+         size_t gws[2];
+         gws[0]= lws[0] * host.nwg(tileDef, lws[0]);
+         gws[1]= lws[1] * host.nwg(n * tileDef, lws[1]);
+         r= clEnqueueNDRangeKernel(q, idKern, 2, NULL, gws, lws, 0, NULL, NULL);
+      }
+      if (r >= 0) { r= clEnqueueReadBuffer(q, device.hI, CL_BLOCKING, 0, n * tileDef * tileDef * sizeof(MapElement), pT, 0, NULL, NULL); }
+      return(r >= 0);
+   } // render
+}; // CTileRenderOCL
+
+
+/***/
+
+// Request bytes received so far on a connection
+struct PartReq
+{
+   TileReq  req;
+   size_t   have;
+}; // PartReq
+
+struct Pending
+{
+   int      fd;
+   TileReq  req;
+   TimeValF t;
+   int      iM; // index in batch of misses
+}; // Pending
+
+class CTileService
+{
+protected:
+   CTileRenderOCL  &ren;
+   CTileCache     cache;
+   CElapsedTime   clk;
+   ServiceStats   stats;
+   std::vector<Pending> pend;
+   MapElement     *pT;
+   size_t         lws[2];
+   bool           run;
+
+   bool reply (Pending& p, int32_t status, const void *pData=NULL, uint32_t bytes=0)
+   {
+      TileResp h= { status, p.req.id, bytes };
+      bool r= sendAll(p.fd, &h, sizeof(h)) && ((0 == bytes) || sendAll(p.fd, pData, bytes));
+      TimeValF l= clk.get() - p.t;
+      stats.sumLatency+= l;
+      stats.maxLatency= std::max(stats.maxLatency, l);
+      return(r);
+   } // reply
+
+   // Resolve pending requests: cache hits answered directly, distinct misses rendered in batches
+   void process (void)
+   {
+      std::vector<TileKey> miss;
+      const size_t tb= cache.tileBytes();
+
+      for (Pending& p : pend)
+      {
+         stats.requests++;
+         p.iM= -1;
+         switch(p.req.op)
+         {
+            case TO_TILE :
+               if (!CTileRenderOCL::valid(p.req.k)) { reply(p, TS_INVALID); }
+               else
+               {
+                  const uint64_t key= p.req.k.pack();
+                  for (size_t i=0; i<miss.size(); i++) { if (miss[i].pack() == key) { p.iM= i; break; } }
+                  if ((p.iM < 0) && cache.get(pT, p.req.k)) { reply(p, TS_CACHED, pT, tb); }
+                  else if (p.iM < 0) { p.iM= miss.size(); miss.push_back(p.req.k); }
+               }
+               break;
+            case TO_STATS :
+               stats.cache= cache.stats;
+               reply(p, TS_OK, &stats, sizeof(stats));
+               break;
+            case TO_QUIT : run= false; reply(p, TS_OK); break;
+            default : reply(p, TS_INVALID); break;
+         }
+      }
+      for (size_t i0=0; i0 < miss.size(); i0+= TILE_BATCH)
+      {
+         const int n= std::min<size_t>(TILE_BATCH, miss.size() - i0);
+         clk.elapsed();
+         bool ok= ren.render(pT, miss.data() + i0, n, lws);
+         stats.renderSec+= clk.elapsed();
+         stats.batches++;
+         if (ok)
+         {
+            stats.rendered+= n;
+            for (int i=0; i<n; i++) { cache.put(miss[i0+i], pT + i * (tb / sizeof(MapElement))); }
+         }
+         for (Pending& p : pend)
+         {
+            if ((p.iM >= (int)i0) && (p.iM < (int)i0 + n))
+            {
+               if (ok) { reply(p, TS_OK, pT + (p.iM - i0) * (tb / sizeof(MapElement)), tb); }
+               else { reply(p, TS_FAIL); }
+            }
+         }
+      }
+      pend.clear();
+   } // process
+
+   // Discard requests queued by a client before its descriptor is closed (and possibly reused by accept)
+   void drop (const int fd)
+   {
+      size_t j= 0;
+      for (size_t i=0; i<pend.size(); i++) { if (pend[i].fd != fd) { pend[j++]= pend[i]; } }
+      pend.resize(j);
+   } // drop
+
+public:
+   CTileService (CTileRenderOCL& r, const char *spillDir) : ren(r), cache(CACHE_TILES, TILE_DEF * TILE_DEF, spillDir), run{true}
+   {
+      pT= new MapElement[TILE_BATCH * TILE_DEF * TILE_DEF];
+      lws[0]= lws[1]= 16;
+   }
+   ~CTileService () { delete [] pT; }
+
+   int serve (const char path[])
+   {
+      std::vector<struct pollfd> pfd;
+      std::vector<PartReq> part; // per descriptor in pfd (listening socket unused)
+      TimeValF tFirst=0;
+
+      pfd.push_back({ openSocket(path, true), POLLIN, 0 });
+      part.push_back({ {}, 0 });
+      if (pfd[0].fd < 0) { std::cout << "failed to open " << path << std::endl; return(-1); }
+      std::cout << "serving on " << path << std::endl;
+      while (run)
+      {
+         int wait= -1;
+         if (pend.size() > 0) { wait= std::max(0, (int)(BATCH_WINDOW_MS - 1000 * (clk.get() - tFirst))); }
+         int nr= poll(pfd.data(), pfd.size(), wait);
+
+         if ((nr > 0) && (pfd[0].revents & POLLIN))
+         {
+            int fd= accept(pfd[0].fd, NULL, NULL);
+            if (fd >= 0)
+            {
+               if (pfd.size() > MAX_CLIENT) { close(fd); } // refuse
+               else { pfd.push_back({ fd, POLLIN, 0 }); part.push_back({ {}, 0 }); }
+            }
+         }
+         for (size_t i=1; (nr > 0) && (i < pfd.size()); i++)
+         {
+            if (0 == pfd[i].revents) { continue; }
+            PartReq& q= part[i];
+            Pending p;
+            ssize_t b;
+            p.fd= pfd[i].fd;
+            // Drain the socket, so a partial request is kept until the rest arrives
+            // (rather than left readable, waking poll() immediately)
+            while ((b= recv(p.fd, (char*)&(q.req) + q.have, sizeof(q.req) - q.have, MSG_DONTWAIT)) > 0)
+            {
+               q.have+= b;
+               if (sizeof(q.req) == q.have)
+               {
+                  p.req= q.req;
+                  p.t= clk.get();
+                  if (pend.empty()) { tFirst= p.t; }
+                  pend.push_back(p);
+                  q.have= 0;
+               }
+            }
+            // Orderly shutdown, socket error or hangup (once received data is drained) all disconnect
+            if ((0 == b) || ((EAGAIN != errno) && (EWOULDBLOCK != errno)) || (pfd[i].revents & (POLLHUP|POLLERR|POLLNVAL)))
+            {
+               drop(p.fd);
+               close(p.fd);
+               pfd.erase(pfd.begin() + i);
+               part.erase(part.begin() + i); --i;
+            }
+         }
+         // Launch when a batch is full or the coalescing window has expired
+         if ((pend.size() >= TILE_BATCH) || ((pend.size() > 0) && (1000 * (clk.get() - tFirst) >= BATCH_WINDOW_MS))) { process(); }
+      }
+      for (struct pollfd& p : pfd) { close(p.fd); }
+      unlink(path);
+      return(0);
+   } // serve
+}; // CTileService
+
+
+/***/
+
+struct ClientLatency
+{
+   size_t   n, bad;
+   TimeValF sum, max;
+   size_t   status[TS_FAIL+1];
+}; // ClientLatency
+
+// Pan over all tiles of levels 0..3 twice, each level a burst of pipelined requests
+void clientSession (const char path[], const int c, ClientLatency *pL)
+{
+   CTimestamp clk;
+   std::vector<TimeValF> tSend;
+   int fd= openSocket(path, false);
+
+   memset(pL, 0, sizeof(*pL));
+   if (fd < 0) { pL->bad= 1; return; }
+   MapElement *pT= new MapElement[TILE_DEF * TILE_DEF];
+   for (int pass=0; pass<2; pass++)
+   {
+      for (int level=0; level<4; level++)
+      {
+         const int m= 1 << level;
+         tSend.clear();
+         for (int j=0; j < m*m; j++)
+         {
+            const int k= (j + c * 7) % (m*m); // vary order per client
+            TileReq q= { TO_TILE, (uint32_t)j, { c % nTileView, level, k % m, k / m } };
+            tSend.push_back(clk.get());
+            sendAll(fd, &q, sizeof(q));
+         }
+         for (int j=0; j < m*m; j++)
+         {
+            TileResp h;
+            if (!recvAll(fd, &h, sizeof(h)) || (h.bytes > sizeof(*pT) * TILE_DEF * TILE_DEF) || !recvAll(fd, pT, h.bytes)) { pL->bad++; break; }
+            if (h.id >= tSend.size()) { pL->bad++; continue; }
+            TimeValF l= clk.get() - tSend[h.id];
+            pL->n++; pL->sum+= l; pL->max= std::max(pL->max, l);
+            if ((h.status >= 0) && (h.status <= TS_FAIL)) { pL->status[h.status]++; }
+         }
+      }
+   }
+   delete [] pT;
+   close(fd);
+} // clientSession
+
+int client (const char path[], bool quit)
+{
+   std::thread th[NUM_CLIENT];
+   ClientLatency l[NUM_CLIENT], s;
+   int fd=-1;
+
+   for (int i=0; (i < 200) && (fd < 0); i++) { fd= openSocket(path, false); if (fd < 0) { usleep(50000); } } // wait for server
+   if (fd < 0) { std::cout << "failed to connect " << path << std::endl; return(-1); }
+
+   CElapsedTime t;
+   for (int c=0; c<NUM_CLIENT; c++) { th[c]= std::thread(clientSession, path, c, l+c); }
+   for (int c=0; c<NUM_CLIENT; c++) { th[c].join(); }
+   TimeValF tS= t.elapsed();
+
+   memset(&s, 0, sizeof(s));
+   for (int c=0; c<NUM_CLIENT; c++)
+   {
+      s.n+= l[c].n; s.bad+= l[c].bad; s.sum+= l[c].sum; s.max= std::max(s.max, l[c].max);
+      for (int i=0; i<=TS_FAIL; i++) { s.status[i]+= l[c].status[i]; }
+   }
+   std::cout << "client: " << NUM_CLIENT << " connections, " << s.n << " tiles in " << tS << "sec (" << s.bad << " errors)" << std::endl;
+   std::cout << "\trendered: " << s.status[TS_OK] << ", cached: " << s.status[TS_CACHED] << ", failed: " << s.status[TS_INVALID] + s.status[TS_FAIL] << std::endl;
+   if (s.n > 0) { std::cout << "\tlatency: mean " << s.sum / s.n << "sec, max " << s.max << "sec" << std::endl; }
+
+   TileReq q= { TO_STATS, 0, { 0, 0, 0, 0 } };
+   TileResp h;
+   ServiceStats ss;
+   if (sendAll(fd, &q, sizeof(q)) && recvAll(fd, &h, sizeof(h)) && (sizeof(ss) == h.bytes) && recvAll(fd, &ss, sizeof(ss)))
+   {
+      const TileCacheStats& c= ss.cache;
+      std::cout << "server: " << ss.requests << " requests, " << ss.rendered << " tiles rendered in " << ss.batches << " batches, " << ss.renderSec << "sec" << std::endl;
+      std::cout << "\tcache: hit rate " << c.hitRate() << " (memory " << c.hits << ", disk " << c.diskHits << ", miss " << c.misses << "), ";
+      std::cout << c.evictions << " evictions, " << c.spills << " spilled" << std::endl;
+      if (ss.requests > 0) { std::cout << "\tlatency: mean " << ss.sumLatency / ss.requests << "sec, max " << ss.maxLatency << "sec" << std::endl; }
+   }
+   if (quit)
+   {
+      q.op= TO_QUIT;
+      if (sendAll(fd, &q, sizeof(q))) { recvAll(fd, &h, sizeof(h)); }
+   }
+   close(fd);
+   return(s.bad > 0);
+} // client
+
+int server (const char path[], const char *spill)
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      CTileRenderOCL *pR= new CTileRenderOCL;
+      if (pR->create(idDev[0]) && pR->createTiles(TILE_DEF, TILE_BATCH))
+      {
+         if (pR->defaultBuild(tileKernSrc, "image"))
+         {
+            if (spill) { mkdir(spill, 0755); }
+            std::cout << "server ready: " << pR->elapsed() << "sec" << std::endl;
+            CTileService svc(*pR, spill);
+            r= svc.serve(path);
+         }
+         else { pR->reportBuildLog(); }
+      }
+      delete pR;
+   }
+   return(r);
+} // server
+
+int main (int argc, char *argv[])
+{
+   const char *path= (argc > 2) ? argv[2] : "/tmp/ocl11.sock";
+   const char *spill= (argc > 3) ? argv[3] : NULL; // optional disk spill
+
+   if (argc > 1)
+   {
+      if (0 == strcmp(argv[1], "serve")) { return server(path, spill); }
+      if (0 == strcmp(argv[1], "client")) { return client(path, false); }
+   }
+   pid_t pid= fork();
+   if (0 == pid) { return server(path, spill); }
+   if (pid < 0) { return(-1); }
+   int r= client(path, true), s=0;
+   waitpid(pid, &s, 0);
+   return(r);
+} // main
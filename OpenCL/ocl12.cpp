@@ -0,0 +1,110 @@
+// ocl12.cpp - Per work group load profile of Mandelbrot set: imbalance statistics & heatmaps.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/ProfileOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+// Mandelbrot (ocl3) with profile hooks: iteration count is the load measure.
+// Entry point only, built after the shared iteration functions (mandelFuncSrc)
+const char mandelWGKernSrc[]=
+"kernel void image (__global int *pI, const ushort2 def, const float2 c0, const float2 dc WG_PROFILE_ARG)\n" \
+"{ ushort2 u; float2 c;\n" \
+"  WG_BEGIN\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    c.x= c0.x + dc.x * u.x;\n" \
+"    c.y= c0.y + dc.y * u.y;\n" \
+"    const int i= mandel(&c, 256, 1E12);\n" \
+"    WG_COUNT(i);\n" \
+"    pI[(size_t)u.y * def.x + u.x]= i; }\n" \
+"  WG_END }\n";
+
+
+/***/
+Def2D gDef={512,512};
+
+// Whole set (interior heavy) and a boundary zoom
+const MandelGeomArgs view[]= { MandelGeomArgs(Complex2D(-0.75, 0), Complex2D(1.5,1.5)), MandelGeomArgs(Complex2D(-0.909, -0.275), Complex2D(0.3,0.3)) };
+const int nView= sizeof(view) / sizeof(view[0]);
+
+// Candidate work group shapes
+const size_t lwsTab[][2]= { {8,8}, {16,16}, {32,8}, {8,32}, {32,32} };
+const int nLWS= sizeof(lwsTab) / sizeof(lwsTab[0]);
+
+CMapImageOCL img; // global to avoid segment violation
+CWorkGroupProfile prof;
+CMapImage2D heat;
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      TimeValF t[3], tk[nView][nLWS];
+
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      {
+         const char *src[3]= { wgNoProfileSrc, mandelFuncSrc, mandelWGKernSrc };
+
+         t[0]= img.elapsed();
+         std::cout << "context created: " << t[0] << "sec" << std::endl;
+         r= 0;
+         // Plain build for unperturbed timing
+         if (!img.defaultBuild(src, 3, "image")) { img.reportBuildLog(); return(-1); }
+         for (int v=0; v<nView; v++)
+         {
+            for (int l=0; l<nLWS; l++)
+            {
+               size_t lws[2]= { lwsTab[l][0], lwsTab[l][1] };
+               tk[v][l]= 0;
+               if (img.fitLWS(lws)) { tk[v][l]= img.execute(lws, view[v], t, false) ? t[1] : 0; } // skip shapes beyond device limits
+            }
+         }
+         src[0]= wgProfileSrc;
+         if (!img.defaultBuild(src, 3, "image")) { img.reportBuildLog(); return(-1); }
+         for (int v=0; v<nView; v++)
+         {
+            std::cout << "view " << v << ":" << std::endl;
+            for (int l=0; l<nLWS; l++)
+            {
+               size_t lws[2]= { lwsTab[l][0], lwsTab[l][1] };
+               if ((tk[v][l] > 0) && prof.create(img.ctx, gDef, lws))
+               {
+                  WGProfileArgs pa= prof.args(view[v]);
+                  if (img.execute(lws, pa, t, false) && prof.read(img.q))
+                  {
+                     WGStats s= prof.stats(gDef);
+                     std::cout << "\t" << lws[0] << "x" << lws[1] << ": kernel " << tk[v][l] << "sec (instrumented " << t[1] << "sec), ";
+                     std::cout << prof.numGroups() << " groups, imbalance " << s.imbalance << ", cv " << s.cv << ", efficiency " << s.efficiency << std::endl;
+                     if ((16 == lws[0]) && (16 == lws[1]) && prof.heatmap(heat, gDef))
+                     {
+                        char name[16];
+                        snprintf(name, sizeof(name), "heat%d.raw", v);
+                        heat.save(name, 1); // convert -size 512x512 -depth 8 gray:heat0.raw heat0.png
+                     }
+                  }
+                  else { r= -1; }
+               }
+            }
+         }
+      }
+   }
+   return(r);
+} // main
@@ -0,0 +1,84 @@
+// ocl13.cpp - Per launch host overhead: virtual GeomArgs vs typed cached argument binding.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+#define NUM_LAUNCH   2000
+#define MOVE_PERIOD  4     // geometry changes on every 4th launch
+
+// Same arguments as DMapGeomArgs (circle distance map, ocl2), typed: centre & radius
+typedef KernArgs<cl_float2, cl_float> DMapKernArgs;
+
+
+/***/
+Def2D gDef={64,64};
+
+CMapImageOCL img; // global to avoid segment violation
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      TimeValF t[3], ta[2]={0,0}, tt[2]={0,0};
+      size_t lws[2]={16,16};
+
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y) && img.defaultBuild(dmapKernSrc, "image"))
+      {
+         const size_t n= img.getHost().numElem();
+         MapElement *pRef= new MapElement[n];
+         DMapGeomArgs ga(8, 8, 12);
+         DMapKernArgs ka;
+         size_t mis= 0;
+
+         img.fitLWS(lws);
+         ka.arg<0>()= { 8, 8 };
+         ka.arg<1>()= 12;
+         for (int typed=0; typed<2; typed++)
+         {
+            for (int i=0; i<NUM_LAUNCH; i++)
+            {
+               if (0 == (i % MOVE_PERIOD))
+               {  // same path for both
+                  const Scalar x= 8 + (i / MOVE_PERIOD) % 48, y= 8 + (i / (2 * MOVE_PERIOD)) % 48;
+                  ga.v[0]= x; ga.v[1]= y;
+                  ka.arg<0>().s[0]= x; ka.arg<0>().s[1]= y;
+               }
+               img.elapsed();
+               if (typed) { img.execute(lws, ka, t, false); } else { img.execute(lws, ga, t, false); }
+               ta[typed]+= t[0];
+               tt[typed]+= t[0] + t[1] + t[2];
+            }
+            img.run(lws, t); // read final map
+            if (0 == typed) { memcpy(pRef, img.getHost().pI, n * sizeof(*pRef)); }
+            else { for (size_t i=0; i<n; i++) { mis+= (pRef[i] != img.getHost().pI[i]); } }
+         }
+         std::cout << NUM_LAUNCH << " launches of " << gDef.x << "x" << gDef.y << " map:" << std::endl;
+         std::cout << "\tGeomArgs:   args " << 1E6 * ta[0] / NUM_LAUNCH << "usec, total " << 1E6 * tt[0] / NUM_LAUNCH << "usec per launch" << std::endl;
+         std::cout << "\tKernArgs:   args " << 1E6 * ta[1] / NUM_LAUNCH << "usec, total " << 1E6 * tt[1] / NUM_LAUNCH << "usec per launch" << std::endl;
+         std::cout << "\tclSetKernelArg calls " << ka.sets << ", avoided " << ka.skips << ", mismatch " << mis << "pix" << std::endl;
+         r= (0 == mis) ? 0 : -1;
+         delete [] pRef;
+      }
+      else { img.reportBuildLog(); }
+   }
+   return(r);
+} // main
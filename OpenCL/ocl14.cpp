@@ -0,0 +1,87 @@
+// ocl14.cpp - Repeated map jobs of varying size: allocation cost with & without buffer pools.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+#define NUM_ROUND    8
+
+// Distance map of a circle at centre (ocl2)
+const char dmapKernSrc[]=
+"kernel void image (__global int *pI, const ushort2 def)\n" \
+"{ ushort2 u;"\
+"  float2 f, c;"\
+"  u.x= get_global_id(0);"\
+"  u.y= get_global_id(1);"\
+"  if ((u.x < def.x) && (u.y < def.y)) {" \
+"    f.x= u.x; f.y= u.y; c.x= 0.5f * def.x; c.y= 0.5f * def.y; "\
+"    int s= distance(f,c) - 0.25f * (def.x + def.y);"\
+"    pI[(size_t)u.y * def.x + u.x]= s; } }";
+
+// Job sizes cycled each round
+const Def2D jobDef[]= { {512,512}, {256,256}, {1024,768}, {384,200}, {640,480}, {500,500} };
+const int nJob= sizeof(jobDef) / sizeof(jobDef[0]);
+
+void report (const char *name, const PoolStats& s)
+{
+   std::cout << "\t" << name << ": " << s.allocs << " allocated, " << s.reuses << " reused (" << 100 * s.reuseRate() << "%), " << s.frees << " freed, ";
+   std::cout << "high water " << (s.highWater >> 10) << "kB, pooled " << (s.pooled >> 10) << "kB" << std::endl;
+} // report
+
+
+/***/
+CMapImageOCL img; // global to avoid segment violation
+EmptyGeomArgs noGA;
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if ((nDev > 0) && img.create(idDev[0]))
+   {
+      TimeValF t[3];
+      size_t lws[2]={16,16};
+
+      if (img.defaultBuild(dmapKernSrc, "image"))
+      {
+         img.fitLWS(lws);
+         r= 0;
+         for (int pool=0; pool<2; pool++)
+         {
+            TimeValF ta=0, tk=0;
+            gHostPool.enabled= gDevPool.enabled= (pool > 0);
+            gHostPool.stats.resetCounts();
+            gDevPool.stats.resetCounts();
+            for (int i=0; i < NUM_ROUND * nJob; i++)
+            {
+               const Def2D& d= jobDef[i % nJob];
+               img.elapsed();
+               if (!img.createArgs(d.x, d.y)) { r= -1; break; }
+               ta+= img.elapsed();
+               if (img.execute(lws, noGA, t)) { tk+= t[1] + t[2]; } else { r= -1; }
+               img.release(false); // keep program
+            }
+            std::cout << (pool ? "pooled:" : "unpooled:") << std::endl;
+            std::cout << "\t" << NUM_ROUND * nJob << " jobs: allocate " << ta << "sec, kernel+read " << tk << "sec" << std::endl;
+            report("host", gHostPool.stats);
+            report("device", gDevPool.stats);
+         }
+      }
+      else { img.reportBuildLog(); }
+   }
+   return(r);
+} // main
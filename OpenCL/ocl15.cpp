@@ -0,0 +1,94 @@
+// ocl15.cpp - Element-wise vector expressions: fused generated kernels vs one kernel per operation.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <cmath>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/FuseOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+#define VEC_ELEM  (1<<22)
+#define NUM_REP   16
+
+CVecExprOCL vx; // global to avoid segment violation
+DevVec a, b, c, d, res;
+cl_float *pA, *pB, *pC, *pD, *pR;
+
+void initData (void)
+{
+   for (size_t i= 0; i < VEC_ELEM; i++)
+   {
+      const double theta= i * M_PI / (1<<8);
+      pA[i]= sin(theta); pB[i]= cos(theta);
+      pC[i]= 1 + (i & 0xF); pD[i]= 0.5 * (i & 0x7);
+   }
+} // initData
+
+// Evaluate expression fused and unfused, compare timing & traffic, verify against host function
+template <typename E, typename H> int bench (const char name[], const E& e, H h)
+{
+   TimeValF t[2][2];
+   FuseStats s[2];
+   double err= 0;
+
+   std::cout << name << ":" << std::endl;
+   for (int fuse=1; fuse>=0; fuse--)
+   {
+      vx.stats.clear();
+      vx.elapsed();
+      if (!vx.eval(res, e, fuse)) { vx.reportBuildLog(); return(-1); }
+      t[fuse][0]= vx.elapsed(); // includes build
+      s[fuse]= vx.stats;
+      for (int i=0; i<NUM_REP; i++)
+      {
+         if (!vx.eval(res, e, fuse)) { std::cout << "\teval failed (repeat " << i << ")" << std::endl; return(-1); }
+      }
+      t[fuse][1]= vx.elapsed() / NUM_REP;
+      if (!vx.read(pR, res)) { std::cout << "\tread failed" << std::endl; return(-1); }
+      for (size_t i=0; i<VEC_ELEM; i++) { err= std::max<double>(err, fabs(pR[i] - h(i))); }
+   }
+   for (int fuse=1; fuse>=0; fuse--)
+   {
+      std::cout << "\t" << (fuse ? "fused:   " : "unfused: ") << s[fuse].launches << " kernels (" << s[fuse].builds << " built), ";
+      std::cout << (s[fuse].bytes >> 20) << "MB traffic, first " << t[fuse][0] << "sec, then " << t[fuse][1] << "sec" << std::endl;
+   }
+   std::cout << "\tsaved " << ((s[0].bytes - s[1].bytes) >> 20) << "MB, speedup " << t[0][1] / t[1][1] << ", max error " << err << std::endl;
+   return((err < 1E-3) ? 0 : -1);
+} // bench
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if ((nDev > 0) && vx.create(idDev[0]) &&
+      vx.vector(a, VEC_ELEM) && vx.vector(b, VEC_ELEM) && vx.vector(c, VEC_ELEM) && vx.vector(d, VEC_ELEM) && vx.vector(res, VEC_ELEM))
+   {
+      pA= new cl_float[5 * VEC_ELEM];
+      pB= pA + VEC_ELEM; pC= pB + VEC_ELEM; pD= pC + VEC_ELEM; pR= pD + VEC_ELEM;
+      initData();
+      if (vx.write(a, pA) && vx.write(b, pB) && vx.write(c, pC) && vx.write(d, pD))
+      {
+         r= 0;
+         r|= bench("(a + b) * c - d", (a + b) * c - d, [](size_t i){ return (pA[i] + pB[i]) * pC[i] - pD[i]; });
+         r|= bench("2 * a + b", 2 * a + b, [](size_t i){ return 2 * pA[i] + pB[i]; });
+         r|= bench("((a - b) * (a - b) + (c - d) * (c - d)) / 2", ((a - b) * (a - b) + (c - d) * (c - d)) / 2,
+               [](size_t i){ return ((pA[i] - pB[i]) * (pA[i] - pB[i]) + (pC[i] - pD[i]) * (pC[i] - pD[i])) / 2; });
+         r|= bench("0.5 * a + b (cached shape)", 0.5 * a + b, [](size_t i){ return 0.5f * pA[i] + pB[i]; });
+      }
+      delete [] pA;
+      for (DevVec *p : { &a, &b, &c, &d, &res }) { vx.release(*p); }
+   }
+   return(r);
+} // main
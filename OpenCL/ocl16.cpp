@@ -0,0 +1,100 @@
+// ocl16.cpp - Map memory layouts (row-major, square tiles, Morton order) under neighbourhood operations.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/StencilOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+struct LayoutOpt
+{
+   const char  *name;
+   MapLayout   layout;
+   uint8_t     tileShift;
+}; // LayoutOpt
+
+
+/***/
+Def2D gDef={1024,1024};
+
+// Mandelbrot (ocl3) as source map, elements addressed by layout macro
+const MandelGeomArgs mandelGA(-0.909, -0.275, 0.3);
+
+const LayoutOpt layoutOpt[]= { { "row-major", ML_ROW, 0 }, { "tile 8x8", ML_TILE, 3 }, { "tile 32x32", ML_TILE, 5 }, { "Morton 32x32", ML_MORTON, 5 } };
+const int nLayout= sizeof(layoutOpt) / sizeof(layoutOpt[0]);
+
+const StencilStage stage[]= { { &stBlur, 1, BM_CLAMP }, { &stBlur, 4, BM_CLAMP }, { &stGradient, 2, BM_MIRROR }, { &stDilate, 3, BM_ZERO } };
+const int nStage= sizeof(stage) / sizeof(stage[0]);
+
+CStencilMapOCL img; // global to avoid segment violation
+
+// Row-major copy of host map
+void toRows (MapElement r[], const CMapImage2D& m)
+{
+   for (size_t y=0; y < m.def.y; y++) { m.getLine(r + y * m.def.x, y); }
+} // toRows
+
+// Source map & each stencil stage (naive, tiled) under layout, results compared with
+// row-major reference (pRef, filled from first layout). Returns mismatched elements or -1.
+long layoutBench (const LayoutOpt& o, size_t lws[2], size_t sws[2], MapElement *pRef, MapElement *pRow)
+{
+   const size_t n= (size_t)gDef.x * gDef.y;
+   TimeValF t[3], ts[2];
+   long mis= 0;
+
+   img.release(false); // keep context
+   if (!img.setLayout(o.layout, o.tileShift) || !img.createArgs(gDef.x, gDef.y)) { return(-1); }
+   if (!img.buildLayout(mandelKernSrc, "image")) { img.reportBuildLog(); return(-1); }
+   img.elapsed();
+   if (!img.execute(lws, mandelGA, t)) { return(-1); }
+   std::cout << o.name << " (" << img.getHost().numStore() * sizeof(MapElement) / 1024 << "kB):" << std::endl;
+   std::cout << "\tsource map:    " << t[1] << "sec" << std::endl;
+   for (int s=0; s < nStage; s++)
+   {
+      if (!img.buildChain(stage+s, 1, sws)) { img.reportChainLog(); return(-1); }
+      for (int tiled=0; tiled<2; tiled++) { img.applyChain(tiled, ts+tiled); }
+      img.readChain();
+      toRows(pRow, img.getHost());
+      if (ML_ROW == o.layout) { memcpy(pRef + s * n, pRow, n * sizeof(*pRow)); }
+      else { for (size_t i=0; i<n; i++) { mis+= (pRef[s * n + i] != pRow[i]); } }
+      std::cout << "\t" << stage[s].pOp->name << " r=" << stage[s].r << ":\tnaive " << ts[0] << "sec, tiled " << ts[1] << "sec" << std::endl;
+   }
+   if (ML_ROW != o.layout) { std::cout << "\tmismatch vs row-major: " << mis << "pix" << std::endl; }
+   return(mis);
+} // layoutBench
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if ((nDev > 0) && img.create(idDev[0]))
+   {
+      size_t lws[2]={16,16}, sws[2]={16,16};
+      const size_t n= (size_t)gDef.x * gDef.y;
+      MapElement *pRef= new MapElement[(nStage + 1) * n], *pRow= pRef + nStage * n;
+
+      img.fitLWS(lws);
+      r= 0;
+      for (int i=0; (0 == r) && (i < nLayout); i++)
+      {
+         if (0 != layoutBench(layoutOpt[i], lws, sws, pRef, pRow)) { r= -1; }
+      }
+      if (0 == r) { img.save("img.raw"); } // row-major whatever the layout
+      delete [] pRef;
+   }
+   return(r);
+} // main
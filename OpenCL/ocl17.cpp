@@ -0,0 +1,139 @@
+// ocl17.cpp - Map output as image (cl_image) vs buffer: map synthesis, sampler read stencils & colour.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <cstdlib>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/StencilOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+// Mandelbrot (ocl3) as iteration map ("image", shared kernel) or colour, stored
+// through MAP_STORE / MAP_STORE_RGBA so the same source serves buffer or image
+const char colourKernSrc[]=
+"kernel void colour (MAP_OUT pI, const ushort2 def, const float2 c0, const float2 dc)\n" \
+"{ ushort2 u; float2 c;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    c.x= c0.x + dc.x * u.x;\n" \
+"    c.y= c0.y + dc.y * u.y;\n" \
+"    const float f= mandel(&c, MAX_ITER, 1E12) * (1.0f / MAX_ITER);\n" \
+"    MAP_STORE_RGBA(pI, u.x, u.y, def, (float4)(sqrt(f), f * f, sinpi(f), 1)); } }\n";
+
+
+/***/
+Def2D gDef={1024,1024};
+
+const MandelGeomArgs mandelGA(-0.909, -0.275, 0.3);
+
+const StencilStage stage[]= { { &stBlur, 1, BM_CLAMP }, { &stBlur, 4, BM_CLAMP }, { &stBlur, 2, BM_WRAP }, { &stGradient, 2, BM_MIRROR }, { &stDilate, 3, BM_ZERO } };
+const int nStage= sizeof(stage) / sizeof(stage[0]);
+const char *bmName[]= { "clamp", "zero", "wrap", "mirror" };
+
+CStencilMapOCL img; // global to avoid segment violation
+
+// Create map as buffer or image (iteration values, or colour)
+bool create (bool image, bool colour=false)
+{
+   img.release(false); // keep context
+   if (!image) { return img.createArgs(gDef.x, gDef.y); }
+   if (colour) { return img.CMapImageOCL::createImage(gDef.x, gDef.y, CL_RGBA, CL_UNORM_INT8, CL_MEM_WRITE_ONLY|CL_MEM_HOST_READ_ONLY); }
+   return img.createImage(gDef.x, gDef.y);
+} // create
+
+// Iteration map & each stencil stage (naive, tiled) with map as buffer or image.
+// Buffer results are kept in pRef, image results compared. Returns mismatched elements or -1.
+long mapBench (bool image, size_t lws[2], size_t sws[2], MapElement *pRef)
+{
+   const size_t n= (size_t)gDef.x * gDef.y;
+   TimeValF t[3], ts[2];
+   long mis= 0;
+
+   if (!create(image)) { std::cout << (image ? "image" : "buffer") << " map unavailable" << std::endl; return(-1); }
+   if (!img.buildLayout(mandelKernSrc, "image")) { img.reportBuildLog(); return(-1); }
+   img.elapsed();
+   if (!img.execute(lws, mandelGA, t)) { return(-1); }
+   const MapElement *pI= img.getHost().pI;
+   if (image) { for (size_t i=0; i<n; i++) { mis+= (pRef[i] != pI[i]); } }
+   else { memcpy(pRef, pI, n * sizeof(*pI)); }
+   std::cout << (image ? "image" : "buffer") << ":" << std::endl;
+   std::cout << "\tmap:           " << t[1] << "sec, read " << t[2] << "sec" << std::endl;
+   for (int s=0; s < nStage; s++)
+   {
+      MapElement *pR= pRef + (s + 1) * n;
+      if (!img.buildChain(stage+s, 1, sws)) { img.reportChainLog(); return(-1); }
+      for (int tiled=0; tiled<2; tiled++) { img.applyChain(tiled, ts+tiled); }
+      img.readChain();
+      if (image) { for (size_t i=0; i<n; i++) { mis+= (pR[i] != pI[i]); } }
+      else { memcpy(pR, pI, n * sizeof(*pI)); }
+      std::cout << "\t" << stage[s].pOp->name << " r=" << stage[s].r << " " << bmName[stage[s].bm];
+      std::cout << ":\t" << (image ? "sampled " : "naive ") << ts[0] << "sec, tiled " << ts[1] << "sec" << std::endl;
+   }
+   if (image) { std::cout << "\tmismatch vs buffer: " << mis << "pix" << std::endl; }
+   return(mis);
+} // mapBench
+
+// Colour (RGBA 8bit) output to buffer or image, compared as for mapBench()
+long colourBench (bool image, size_t lws[2], MapElement *pRef)
+{
+   const size_t n= (size_t)gDef.x * gDef.y;
+   const char *src[2]= { mandelKernSrc, colourKernSrc };
+   TimeValF t[3];
+   long mis= 0;
+
+   if (!create(image, true)) { return(-1); }
+   if (!img.buildLayout(src, 2, "colour")) { img.reportBuildLog(); return(-1); }
+   img.elapsed();
+   if (!img.execute(lws, mandelGA, t)) { return(-1); }
+   const uint8_t *pC= (const uint8_t*)img.getHost().pI, *pRC= (const uint8_t*)pRef;
+   if (image)
+   {  // channel conversion may round differently
+      for (size_t i=0; i < 4*n; i++) { mis+= (abs(pRC[i] - pC[i]) > 1); }
+   }
+   else { memcpy(pRef, img.getHost().pI, n * sizeof(MapElement)); }
+   std::cout << "colour " << (image ? "image RGBA:  " : "buffer uchar4: ") << t[1] << "sec, read " << t[2] << "sec";
+   if (image) { std::cout << ", mismatch " << mis << " channels"; }
+   std::cout << std::endl;
+   return(mis);
+} // colourBench
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if ((nDev > 0) && img.create(idDev[0]))
+   {
+      size_t lws[2]={16,16}, sws[2]={16,16};
+      const size_t n= (size_t)gDef.x * gDef.y;
+      MapElement *pRef= new MapElement[(nStage + 1) * n];
+
+      img.fitLWS(lws);
+      img.fitLWS(sws);
+      const bool image= img.imageSupport();
+
+      r= 0;
+      if (!image) { std::cout << "no device image support: image paths skipped" << std::endl; }
+      if (0 != mapBench(false, lws, sws, pRef)) { r= -1; }
+      else if (image)
+      {
+         if (0 != mapBench(true, lws, sws, pRef)) { r= -1; }
+         else { img.save("img.raw"); }
+      }
+      if ((0 != colourBench(false, lws, pRef)) || (image && (0 != colourBench(true, lws, pRef)))) { r= -1; }
+      delete [] pRef;
+   }
+   return(r);
+} // main
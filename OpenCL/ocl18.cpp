@@ -0,0 +1,109 @@
+// ocl18.cpp - Concurrent build of kernel variants: time to first kernel & all built, sequential vs concurrent.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+#define NUM_VARIANT  8
+
+
+/***/
+
+// Mandelbrot (ocl3), variants by iteration limit (MAX_ITER) & maths options
+const MandelGeomArgs mandelGA(-0.909, -0.275, 0.3);
+
+CMapImageOCL img; // global to avoid segment violation
+
+// Build options of variant v. The nonce differs per run and mode so that driver
+// program caches do not hide compilation.
+void variantOptions (char opt[], const int max, const int v, const bool concurrent)
+{
+   snprintf(opt, max, "-D MAX_ITER=%d -D BUILD_NONCE=%u%s", 64 << (v >> 1), ((unsigned)getpid() << 1) | concurrent, (v & 1) ? " -cl-fast-relaxed-math" : "");
+} // variantOptions
+
+// Build all variants, one after another or all at once, running the first variant as soon
+// as it is built. Each variant is then run to check its build. Timing in pDT[]: first kernel
+// result, all built (both from start of building)
+bool variantBench (const bool concurrent, size_t lws[2], TimeValF pDT[2])
+{
+   CBuildSetOCL set;
+   char opt[NUM_VARIANT][64];
+   const char *src= mandelKernSrc;
+   TimeValF t= 0;
+   bool ok= true;
+   int fail= -1; // variant failing to build
+   int nStart= 0; // variants started, in order (set index == variant)
+
+   for (int v=0; v < NUM_VARIANT; v++) { variantOptions(opt[v], sizeof(opt[v]), v, concurrent); }
+   img.elapsed();
+   if (concurrent) { while ((nStart < NUM_VARIANT) && (set.start(img.ctx, &src, 1, opt[nStart]) == nStart)) { ++nStart; } }
+   for (int v=0; ok && (v < NUM_VARIANT); v++)
+   {
+      if (!concurrent && (set.start(img.ctx, &src, 1, opt[v]) == v)) { ++nStart; }
+      if (v >= nStart)
+      {
+         std::cout << "variant " << v << " (" << opt[v] << ") failed to start build" << std::endl;
+         ok= false;
+         break;
+      }
+      ok= (set.wait(v) >= 0);
+      if (!ok) { fail= v; }
+      else if (0 == v)
+      {
+         img.adopt(set.take(0));
+         ok= img.select("image") && img.execute(lws, mandelGA);
+         pDT[0]= t+= img.elapsed();
+      }
+   }
+   pDT[1]= t+= img.elapsed();
+   for (int v=1; ok && (v < NUM_VARIANT); v++)
+   {
+      img.adopt(set.take(v));
+      ok= img.select("image") && img.execute(lws, mandelGA);
+   }
+   if (fail >= 0) { set.reportBuildLog(fail, img.getDevice()); }
+   else if (!ok) { img.reportBuildLog(); } // select or execute of adopted program
+   return(ok);
+} // variantBench
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if ((nDev > 0) && img.create(idDev[0]) && img.createArgs(512,512))
+   {
+      size_t lws[2]={16,16};
+      TimeValF t[2][2];
+
+      img.fitLWS(lws);
+      std::cout << NUM_VARIANT << " variants, " << std::thread::hardware_concurrency() << " host threads:" << std::endl;
+      if (variantBench(false, lws, t[0]) && variantBench(true, lws, t[1]))
+      {
+         const char *mode[]= { "sequential", "concurrent" };
+         for (int c=0; c<2; c++)
+         {
+            std::cout << "\t" << mode[c] << ": first kernel " << t[c][0] << "sec, all built " << t[c][1] << "sec" << std::endl;
+         }
+         r= 0;
+      }
+   }
+   return(r);
+} // main
@@ -0,0 +1,114 @@
+// ocl19.cpp - Device side run-length compression of map output: ratio & end-to-end time vs raw output.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <vector>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+#include "Common/RleOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+struct Workload
+{
+   const char     *name, *src;
+   const GeomArgs *pA;
+}; // Workload
+
+
+/***/
+Def2D gDef={1024,1024};
+
+// Kernels of ocl2 & ocl3: element indices (no runs, incompressible), truncated circle distance & Mandelbrot
+const EmptyGeomArgs idxGA;
+const DMapGeomArgs dmapGA(512, 512, 200, 16);
+const MandelGeomArgs mandelGA(-0.75, 0, 1.5), mandelZoomGA(-0.909, -0.275, 0.3);
+
+const Workload workload[]=
+{
+   { "index", idxKernSrc, &idxGA },
+   { "distance (truncated)", dmapTKernSrc, &dmapGA },
+   { "mandelbrot", mandelKernSrc, &mandelGA },
+   { "mandelbrot (zoom)", mandelKernSrc, &mandelZoomGA }
+};
+const int nWorkload= sizeof(workload) / sizeof(workload[0]);
+
+CMapImageOCL img; // global to avoid segment violation
+CMapRLE rle;
+
+// Raw output (read back & save every element) vs run-length compressed on device
+// (transfer & save runs, decoded from file to verify). Returns mismatches or -1.
+long rleBench (const Workload& w, size_t lws[2])
+{
+   const size_t n= img.getHost().numElem();
+   TimeValF t[3], tRaw[3], tRLE[3]; // kernel time of each run kept in [2]
+   size_t bRaw, bRLE, nR;
+   long mis= 0;
+
+   if (!img.defaultBuild(w.src, "image")) { img.reportBuildLog(); return(-1); }
+
+   // raw
+   img.elapsed();
+   if (!img.execute(lws, *(w.pA), t)) { return(-1); }
+   bRaw= img.save("map.raw", 0);
+   tRaw[0]= t[2];
+   tRaw[2]= t[1];
+   tRaw[1]= img.elapsed();
+   std::vector<MapElement> ref(img.getHost().pI, img.getHost().pI + n);
+
+   // compressed
+   img.elapsed();
+   if (!img.execute(lws, *(w.pA), t, false)) { return(-1); }
+   tRLE[2]= t[1];
+   nR= rle.compress(img);
+   tRLE[0]= img.elapsed();
+   if (nR > 0) { bRLE= img.getHost().saveRuns("map.rle", rle.runs.data(), nR); }
+   else { img.read(); bRLE= img.save("map.rle", 0); } // incompressible: raw
+   tRLE[1]= img.elapsed();
+   if (nR > 0)
+   {
+      CMapImage2D d;
+      if (d.loadRuns("map.rle") != n) { mis= n; }
+      else { for (size_t i=0; i<n; i++) { mis+= (ref[i] != d.pI[i]); } }
+      d.release();
+   }
+   const TimeValF tDec= img.elapsed();
+
+   std::cout << w.name << ": " << rle.nRun << " runs, ratio " << rle.ratio() << (nR ? "" : " (raw output)") << std::endl;
+   std::cout << "\traw:  " << bRaw / 1024 << "kB, kernel " << tRaw[2] << "sec, read " << tRaw[0] << "sec, save " << tRaw[1] << "sec, total " << tRaw[2] + tRaw[0] + tRaw[1] << "sec" << std::endl;
+   std::cout << "\tRLE:  " << bRLE / 1024 << "kB, kernel " << tRLE[2] << "sec, compress+read " << tRLE[0] << "sec, save " << tRLE[1] << "sec, total " << tRLE[2] + tRLE[0] + tRLE[1] << "sec" << std::endl;
+   if (nR > 0) { std::cout << "\tdecode (load): " << tDec << "sec, mismatch " << mis << "pix" << std::endl; }
+   return(mis);
+} // rleBench
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if ((nDev > 0) && img.create(idDev[0]) && img.createArgs(gDef.x, gDef.y, CL_MEM_READ_WRITE|CL_MEM_HOST_READ_ONLY))
+   {
+      size_t lws[2]={16,16};
+
+      img.fitLWS(lws);
+      if (rle.create(img))
+      {
+         r= 0;
+         for (int i=0; i<nWorkload; i++) { if (0 != rleBench(workload[i], lws)) { r= -1; } }
+      }
+      rle.release();
+   }
+   return(r);
+} // main
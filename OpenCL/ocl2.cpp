@@ -4,10 +4,15 @@
 // (c) Project Contributors May 2021
 
 #include <iostream>
+#include <cmath>
 
 #include "Common/SimpleOCL.hpp" // still needed - include hierarchy issue?
 #include "Common/QueryOCL.hpp"
 #include "Common/MapImageOCL.hpp"
+#include "Common/Energy.hpp"
+#include "Common/ChecksumOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
 
 
 /***/
@@ -17,59 +22,6 @@
 #define MAX_DEV_ID   4
 
 
-/* OpenCL kernel sources */
-
-// Generate a simple map of element indices - easily verified
-const char idxKernSrc[]=
-"kernel void image (__global int *pI, const ushort2 def)\n" \
-"{ size_t x= get_global_id(0); if (x < def.x)" \
-"   { size_t y= get_global_id(1); if (y < def.y)" \
-"      {   size_t i= y * def.x + x;" // Compute 1D index using row stride <def.x>
-"          pI[i]= i; } } }";
-
-// Generate distance map of a circle - visually verifiable
-const char dmapKernSrc[]=
-"kernel void image (__global int *pI, const ushort2 def, const float2 c, const float r)\n" \
-"{ ushort2 u;"\
-"  float2 f;"\
-"  u.x= get_global_id(0);"\
-"  u.y= get_global_id(1);"\
-"  if ((u.x < def.x) && (u.y < def.y)) {" \
-"    f.x= u.x; f.y= u.y; "\
-"    int s= distance(f,c) - r;"\
-"    pI[(size_t)u.y * def.x + u.x]= s; } }";
-
-struct Coord2D
-{
-   union { struct { Scalar x,y; }; Scalar s[2]; }; // anon
-
-   Coord2D (Scalar kx=0, Scalar ky=0) { x= kx; y= ky; }
-}; // Coord2D
-
-class DMapGeomArgs : public GeomArgs
-{
-public:
-   Scalar v[3];
-   //uint8_t
-
-   DMapGeomArgs (const Coord2D& c, Scalar r)
-   {
-      v[0]= c.x; v[1]= c.y; v[2]= r;
-   }
-
-   uint8_t nArgs (void) const override { return(2); }
-
-   const Scalar *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
-   {
-      switch(i)
-      {
-         case 0 :    bytes= 2 * sizeof(v[0]); return(v+0); // break;
-         case 1 :    bytes= sizeof(v[2]); return(v+2); // break;
-         default :   bytes= 0; return(NULL);
-      }
-   }
-}; // DMapGeomArgs
-
 int verify (const CMapImageOCL& m)
 {
    int r= -1;
@@ -92,7 +44,82 @@ KernInfo idxKI(idxKernSrc, &idxGA);
 DMapGeomArgs dmapGA(Coord2D(0.5*gDef.x,0.5*gDef.y),0.125*(gDef.x+gDef.y));
 KernInfo dmapKI(dmapKernSrc, &dmapGA);
 
+DMapGeomArgs dmapTGA(Coord2D(0.3*gDef.x,0.4*gDef.y),0.05*(gDef.x+gDef.y), 8);
+
 CMapImageOCL img; // global to avoid segment violation
+CEnergyMeter gEnergy;
+CMapChecksum gCheck;
+
+// Distance map: 7 floating point operations per pixel (distance as 2 sub, 2 mul, add, sqrt; less radius)
+#define DMAP_FLOP_PIX 7
+
+// Energy of phases in t[] (intervals from iE), then per frame over repeated frames
+void energy (size_t lws[2], const GeomArgs& ga, const TimeValF t[5], const uint32_t iE)
+{
+   const char *phase[]= { "context", "build", "args", "kernel", "buffer-out" };
+   const double flop= DMAP_FLOP_PIX * (double)img.getHost().numElem();
+   EnergyValF j;
+   TimeValF tf;
+
+   std::cout << "energy (" << gEnergy.name() << ", " << gEnergy.channels() << " channels):" << std::endl;
+   for (int i=0; i<5; i++) { energyReport(phase[i], gEnergy.joules(iE+i), t[i], 1, (3 == i) ? flop : 0); }
+   img.pSink= NULL; // single sample over all frames
+   uint32_t n= energyFrames(gEnergy, [&](){ img.execute(lws, ga); }, j, tf);
+   energyReport("frames", j, tf, n, flop);
+   img.pSink= &gEnergy;
+} // energy
+
+// Device checksum against host computed equivalent, then golden result of distance map
+int golden (const size_t lws[2])
+{
+   char key[32];
+   if (!gCheck.create(img, lws)) { return(-1); }
+   img.elapsed();
+   MapHash d;
+   if (!gCheck.compute(img, d)) { std::cout << "device checksum failed" << std::endl; return(-1); }
+   const TimeValF t= img.elapsed();
+   if (d != gCheck.host(img.getHost())) { std::cout << "device checksum disagrees with host" << std::endl; return(-1); }
+   std::cout << "device checksum: " << t << "sec" << std::endl;
+   snprintf(key, sizeof(key), "dmap-%dx%d", gDef.x, gDef.y);
+   return gCheck.verify(img, key);
+} // golden
+
+#define EDIT_STEPS 16
+
+// Interactive editing: move truncated circle in small steps, re-rendering only
+// the dirty region, and compare (device checksum) against full frame render of the same geometry.
+int edit (size_t lws[2])
+{
+   TimeValF t[3], tu=0, tf=0, tc=0;
+   const size_t n= img.getHost().numElem();
+   size_t mis= 0, area= 0;
+   MapHash hU, hF;
+
+   // No host copy of the map is held (compared by device checksum), so any return is safe
+   if (!img.defaultBuild(dmapTKernSrc, "image")) { img.reportBuildLog(); return(-1); }
+   if (!img.execute(lws, dmapTGA)) { return(-1); }
+   for (int i=0; i<EDIT_STEPS; i++)
+   {
+      dmapTGA.move(3, 2);
+      img.elapsed();
+      bool okU= img.update(lws, dmapTGA, t);
+      tu+= t[0] + t[1] + t[2];
+      area+= img.getDirty().s[0] * img.getDirty().s[1];
+      okU= okU && gCheck.compute(img, hU);
+      tc+= img.elapsed();
+      const bool okF= img.execute(lws, dmapTGA, t);
+      tf+= t[0] + t[1] + t[2];
+      mis+= !okU || !okF || !gCheck.compute(img, hF) || (hU != hF); // launch or checksum failure counts as mismatch
+      img.elapsed();
+   }
+   std::cout << "edit (" << EDIT_STEPS << " moves):" << std::endl;
+   std::cout << "\tdirty:      " << (float)area / (EDIT_STEPS * n) << " of frame" << std::endl;
+   std::cout << "\tupdate:     " << tu / EDIT_STEPS << "sec" << std::endl;
+   std::cout << "\tfull frame: " << tf / EDIT_STEPS << "sec (" << tf / tu << "x)" << std::endl;
+   std::cout << "\tchecksum:   " << tc / EDIT_STEPS << "sec" << std::endl;
+   std::cout << "\tmismatch:   " << mis << " frames" << std::endl;
+   return((0 == mis) ? 0 : -1);
+} // edit
 
 int main (int argc, char *argv[])
 {
@@ -100,14 +127,16 @@ int main (int argc, char *argv[])
    cl_device_id   idDev[MAX_DEV_ID]={0,};
    cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
    int r=-1;
+   uint32_t iE= 0;
 
+   if (gEnergy.open()) { img.pSink= &gEnergy; iE= gEnergy.count(); }
    if (nDev > 0)
    {
       //CImageOCL img; // destruction causes segment violation inside clReleaseContext()
       TimeValF t[5];
       size_t lws[2]={32,32};
 
-      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y,CL_MEM_READ_WRITE|CL_MEM_HOST_READ_ONLY)) // device readable for checksum
       {
          KernInfo *pKI= &dmapKI;
          t[0]= img.elapsed();
@@ -119,12 +148,15 @@ int main (int argc, char *argv[])
 
             if (img.execute(lws, *(pKI->pA), t+2))
             {
-               if (0 == pKI->pA->nArgs()) { r= verify(img); } else { r= 0; }
+               if (0 == pKI->pA->nArgs()) { r= verify(img); } else { r= golden(lws); }
                std::cout << "execution: r=" << r << std::endl;
                std::cout << "\targs:       " << t[2] << "sec"  << std::endl;
                std::cout << "\tkernel:     " << t[3] << "sec"  << std::endl;
                std::cout << "\tbuffer-out: " << t[4] << "sec"  << std::endl;
                img.save("img.raw"); // convert -size 256x256 -depth 32 img.raw img.rgb
+               if (gEnergy.valid()) { energy(lws, *(pKI->pA), t, iE); }
+               const int e= edit(lws); // independent of golden result
+               if (0 == r) { r= e; }
             }
          }
          else { img.reportBuildLog(); }
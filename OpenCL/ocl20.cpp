@@ -0,0 +1,189 @@
+// ocl20.cpp - Single benchmark driver: registered workloads swept over runtime options.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// e.g. ocl20 -w mandel,distance -s 512,1024x768,2048 -l 8x8,16x16,32x8 -n 10
+// Every combination of workload, size and local work size is run; one line each.
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/WorkloadOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+#define SWEEP_MAX    16 // values of each swept option
+
+
+/***/
+
+struct SweepOpt
+{
+   CWorkload   *pW[SWEEP_MAX];
+   Def2D       def[SWEEP_MAX];
+   size_t      lws[SWEEP_MAX][2];
+   int         nW, nDef, nLWS, dev, reps;
+   WorkOpt     wo;
+
+   SweepOpt (void) : nW{0}, nDef{1}, nLWS{1}, dev{0}, reps{5}
+   {
+      def[0]= wo.def;
+      lws[0][0]= wo.lws[0]; lws[0][1]= wo.lws[1];
+   }
+}; // SweepOpt
+
+CVecAddWork    gVecAdd;
+CIndexWork     gIndex;
+CDistanceWork  gDistance;
+CMandelWork    gMandel;
+CWorkloadRegistry gReg;
+
+void usage (const char *name)
+{
+   std::cout << "usage: " << name << " [-w workload,...] [-d device] [-s W[xH],...] [-l X[xY],...] [-v x,y,s] [-i iter] [-n reps] [-r]" << std::endl;
+   std::cout << "\t-w: ";
+   for (size_t i=0; i<gReg.size(); i++) { std::cout << gReg[i]->name << " "; }
+   std::cout << "(any unique prefix, default all)" << std::endl;
+   std::cout << "\t-s: map definitions (vector length W*H), -l: local work sizes, -v: view, -r: include read back" << std::endl;
+} // usage
+
+// Comma separated list of "A" or "AxB" (B defaults to A, or to 1 if square is false)
+int parsePairs (size_t v[][2], const int max, const char s[], const bool square)
+{
+   int n= 0;
+   const char *p= s;
+   while ((n < max) && *p)
+   {
+      char *e;
+      v[n][0]= strtoul(p, &e, 10);
+      v[n][1]= square ? v[n][0] : 1;
+      if ('x' == *e) { v[n][1]= strtoul(e+1, &e, 10); }
+      if ((e == p) || (0 == v[n][0]) || (0 == v[n][1]) || ((',' != *e) && (0 != *e))) { return(-1); }
+      ++n;
+      p= (',' == *e) ? e+1 : e;
+   }
+   return(n);
+} // parsePairs
+
+bool parseArgs (SweepOpt& o, int argc, char *argv[])
+{
+   size_t v[SWEEP_MAX][2];
+   int c, n;
+
+   while ((c= getopt(argc, argv, "w:d:s:l:v:i:n:rh")) >= 0)
+   {
+      switch(c)
+      {
+         case 'w' :
+         {
+            char *s= strdup(optarg);
+            o.nW= 0;
+            for (char *t= strtok(s, ","); t && (o.nW < SWEEP_MAX); t= strtok(NULL, ","))
+            {
+               CWorkload *p= gReg.find(t);
+               if (NULL == p) { std::cout << "unknown workload: " << t << std::endl; free(s); return(false); }
+               o.pW[o.nW++]= p;
+            }
+            free(s);
+            break;
+         }
+         case 'd' : o.dev= atoi(optarg); break;
+         case 's' :
+            if ((n= parsePairs(v, SWEEP_MAX, optarg, true)) <= 0) { return(false); }
+            for (int i=0; i<n; i++)
+            {
+               if ((v[i][0] > 0xFFFF) || (v[i][1] > 0xFFFF)) { return(false); }
+               o.def[i].x= v[i][0]; o.def[i].y= v[i][1];
+            }
+            o.nDef= n;
+            break;
+         case 'l' :
+            if ((n= parsePairs(v, SWEEP_MAX, optarg, false)) <= 0) { return(false); }
+            for (int i=0; i<n; i++) { o.lws[i][0]= v[i][0]; o.lws[i][1]= v[i][1]; }
+            o.nLWS= n;
+            break;
+         case 'v' :
+            if (3 != sscanf(optarg, "%f,%f,%f", o.wo.view+0, o.wo.view+1, o.wo.view+2)) { return(false); }
+            o.wo.viewSet= true;
+            break;
+         case 'i' : o.wo.iter= std::max(1, atoi(optarg)); break;
+         case 'n' : o.reps= std::max(1, atoi(optarg)); break;
+         case 'r' : o.wo.readBack= true; break;
+         default : return(false);
+      }
+   }
+   if (0 == o.nW) { for (size_t i=0; (i < gReg.size()) && (o.nW < SWEEP_MAX); i++) { o.pW[o.nW++]= gReg[i]; } }
+   return(true);
+} // parseArgs
+
+// Setup then reps runs of workload: report local work size launched, setup, minimum & mean time, rates
+bool bench (CWorkload& w, cl_device_id id, const WorkOpt& o, const int reps)
+{
+   CElapsedTime et;
+   TimeValF tS, t, tMin=0, tSum=0;
+
+   et.elapsed();
+   if (!w.setup(id, o)) { return(false); }
+   tS= et.elapsed();
+   for (int i=0; i<reps; i++)
+   {
+      if (!w.run(o, t)) { return(false); }
+      if ((0 == i) || (t < tMin)) { tMin= t; }
+      tSum+= t;
+   }
+   std::cout << w.name << "\t" << o.def.x << "x" << o.def.y << "\t" << w.lwsRun[0] << "x" << w.lwsRun[1] << "\t" << reps << "\t"; // as launched
+   std::cout << tS << "\t" << tMin << "\t" << tSum / reps << "\t";
+   if (tMin > 0) { std::cout << 1E-6 * w.items(o) / tMin << "\t" << 1E-9 * w.bytes(o) / tMin; }
+   std::cout << std::endl;
+   return(true);
+} // bench
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   SweepOpt       so;
+   int r=-1;
+
+   gReg.add(&gVecAdd);
+   gReg.add(&gIndex);
+   gReg.add(&gDistance);
+   gReg.add(&gMandel);
+   if (!parseArgs(so, argc, argv)) { usage(argv[0]); return(r); }
+
+   cl_uint nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   if ((so.dev >= 0) && (so.dev < (int)nDev))
+   {
+      WorkOpt o= so.wo;
+      r= 0;
+      std::cout << "workload\tsize\tlws\treps\tsetup(s)\tmin(s)\tmean(s)\tMitem/s\tGB/s" << std::endl;
+      for (int iW=0; iW < so.nW; iW++)
+      {
+         for (int iD=0; iD < so.nDef; iD++)
+         {
+            o.def= so.def[iD];
+            for (int iL=0; iL < so.nLWS; iL++)
+            {
+               o.lws[0]= so.lws[iL][0]; o.lws[1]= so.lws[iL][1];
+               if (!bench(*(so.pW[iW]), idDev[so.dev], o, so.reps))
+               {
+                  std::cout << so.pW[iW]->name << "\t" << o.def.x << "x" << o.def.y << "\t" << o.lws[0] << "x" << o.lws[1] << "\tFAILED" << std::endl;
+                  r= -1;
+               }
+            }
+         }
+         so.pW[iW]->release(); // context not held beyond its sweep
+      }
+   }
+   else { std::cout << "device " << so.dev << " unavailable (" << nDev << " found)" << std::endl; }
+   return(r);
+} // main
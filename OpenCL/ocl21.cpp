@@ -0,0 +1,111 @@
+// ocl21.cpp - Map render jobs from multiple producer threads over a shared context: throughput & latency by priority.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+// Usage: ocl21 [workers]
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/JobOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+#define JOBS_PER_PRODUCER  32
+#define MAX_PRODUCER       8
+#define INTERACTIVE_DEF    128   // every fourth job, others batch
+#define BATCH_DEF          256
+
+// Jobs (Mandelbrot, ocl3) & results of one producer: the same sequence of views for every producer
+struct ProducerWork
+{
+   std::vector<MandelGeomArgs>   ga;
+   std::vector<MapElement>       res[JOBS_PER_PRODUCER];
+   int                           failed;
+
+   ProducerWork (void) : failed{0} { ; }
+}; // ProducerWork
+
+
+/***/
+
+CJobServiceOCL gJobs;
+
+Def2D jobDef (int j) { const cl_ushort d= (0 == (j & 3)) ? INTERACTIVE_DEF : BATCH_DEF; return Def2D{ { d, d } }; }
+
+// Submit all jobs (panning along the real axis), then wait for every result
+void producer (ProducerWork *pW)
+{
+   std::future<bool> f[JOBS_PER_PRODUCER];
+
+   pW->ga.clear();
+   pW->ga.reserve(JOBS_PER_PRODUCER); // job geometry must not move
+   pW->failed= 0;
+   for (int j=0; j < JOBS_PER_PRODUCER; j++)
+   {
+      const Def2D d= jobDef(j);
+      pW->ga.emplace_back(-1.5 + j * (2.0 / JOBS_PER_PRODUCER), 0, 0.25);
+      pW->res[j].resize((size_t)d.x * d.y);
+      f[j]= gJobs.submit(MapJob{ pW->res[j].data(), d, &(pW->ga[j]), (0 == (j & 3)) ? JP_INTERACTIVE : JP_BATCH });
+   }
+   for (int j=0; j < JOBS_PER_PRODUCER; j++) { pW->failed+= !f[j].get(); }
+} // producer
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   const int      nWorker= (argc > 1) ? std::max(1, atoi(argv[1])) : 2;
+   int r=-1;
+
+   if ((nDev > 0) && gJobs.create(idDev[0], mandelKernSrc, "image", nWorker))
+   {
+      static ProducerWork work[MAX_PRODUCER];
+      double pix= 0;
+      for (int j=0; j < JOBS_PER_PRODUCER; j++) { const Def2D d= jobDef(j); pix+= (double)d.x * d.y; }
+
+      r= 0;
+      std::cout << gJobs.workers() << " workers (queue & kernel each), " << JOBS_PER_PRODUCER << " jobs per producer:" << std::endl;
+      std::cout << "producers\tjobs/s\tMpix/s\tinteractive mean/max(s)\tbatch mean/max(s)\tmismatch" << std::endl;
+      for (int nP=1; nP <= MAX_PRODUCER; nP<<= 1)
+      {
+         std::vector<std::thread> t;
+         CElapsedTime et;
+         TimeValF dt;
+         long mis= 0;
+         int failed= 0;
+
+         gJobs.getStats(true);
+         et.elapsed();
+         for (int p=0; p < nP; p++) { t.push_back(std::thread(producer, work+p)); }
+         for (std::thread& p : t) { p.join(); }
+         dt= et.elapsed();
+         const JobStats s= gJobs.getStats();
+         for (int p=0; p < nP; p++)
+         {  // same views: results must agree between producers
+            failed+= work[p].failed;
+            for (int j=0; (p > 0) && (j < JOBS_PER_PRODUCER); j++) { mis+= (work[p].res[j] != work[0].res[j]); }
+         }
+         std::cout << nP << "\t" << (dt > 0 ? nP * JOBS_PER_PRODUCER / dt : 0) << "\t" << (dt > 0 ? 1E-6 * nP * pix / dt : 0) << "\t";
+         std::cout << s.meanLatency(JP_INTERACTIVE) << " / " << s.maxLatency[JP_INTERACTIVE] << "\t";
+         std::cout << s.meanLatency(JP_BATCH) << " / " << s.maxLatency[JP_BATCH] << "\t" << mis;
+         if (failed > 0) { std::cout << " (" << failed << " jobs failed)"; r= -1; }
+         if (mis > 0) { r= -1; } // producers must agree
+         std::cout << std::endl;
+      }
+      gJobs.release();
+   }
+   return(r);
+} // main
@@ -1,4 +1,4 @@
-// ocl3.cpp - Mandelbrot set.
+// ocl3.cpp - Mandelbrot set, optionally (commandline "-p") followed by progressive coarse to fine rendering.
 // https://github.com/DrAl-HFS/Compute.git
 // Licence: AGPL3
 // (c) Project Contributors May-July 2021
@@ -9,6 +9,10 @@
 #include "Common/SimpleOCL.hpp"
 #include "Common/QueryOCL.hpp"
 #include "Common/MapImageOCL.hpp"
+#include "Common/Energy.hpp"
+#include "Common/ChecksumOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
 
 /***/
 
@@ -16,73 +20,141 @@
 #define MAX_PF_ID    2
 #define MAX_DEV_ID   4
 
-// TODO: adopt less ugly kernel definition scheme ? #include "mandKern.hpp" ?
-const char mandelKernSrc[]=
-"void csq1 (float2 *pV) { float ty= 2 * pV->x * pV->y; pV->x= pV->x * pV->x - pV->y * pV->y; pV->y= ty; }\n\n" \
-"float csqad1m2 (float2 *pV, const float2 *pC) { csq1(pV); *pV+= *pC; return dot(*pV,*pV); }\n\n" \
-"\n" \
-"int mandel (const float2 *pC, int maxI, float maxM2)\n" \
-"{ int i=0; float2 x= *pC;\n" \
-"  do { ++i;} while ((csqad1m2(&x, pC) < maxM2) && (i < maxI));\n" \
-"  return(i); }\n" \
-"\n" \
-"kernel void image (__global int *pI, const ushort2 def, const float2 c0, const float2 dc)\n" \
-"{ ushort2 u; float2 c;\n" \
-"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
-"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
-"    c.x= c0.x + dc.x * u.x;\n" \
-"    c.y= c0.y + dc.y * u.y;\n" \
-"    pI[(size_t)u.y * def.x + u.x]= mandel(&c, 256, 1E12); } }\n";
-
-struct Complex2D
-{
-   union { struct { Scalar r,i; }; Scalar s[2]; }; // anon
-
-   Complex2D (Scalar kr=0, Scalar ki=0) { r= kr; i= ki; }
-}; // Complex2D
-
-class MandelGeomArgs : public GeomArgs
+// Progressive rendering entry point, built together with the shared Mandelbrot kernel
+const char progKernSrc[]=
+"// Progressive pass at step s: evaluate pixels on the s grid not already done at step 2s\n" \
+"// (unless first pass), stored compactly (row stride of grid) for the host to read back\n" \
+"// only the pass result and fill the s*s blocks, so each pass yields a complete image\n" \
+"kernel void progressive (__global int *pI, const ushort2 def, const float2 c0, const float2 dc, const int s, const int first)\n" \
+"{ const int x= get_global_id(0) * s, y= get_global_id(1) * s;\n" \
+"  if ((x < def.x) && (y < def.y) && (first || (0 != ((x | y) & s)))) {\n" \
+"    float2 c;\n" \
+"    c.x= c0.x + dc.x * x;\n" \
+"    c.y= c0.y + dc.y * y;\n" \
+"    pI[(size_t)(y / s) * ((def.x + s - 1) / s) + (x / s)]= mandel(&c, MAX_ITER, 1E12); } }\n";
+
+// Additional step & first pass flag arguments for progressive kernel
+class ProgressiveGeomArgs : public MandelGeomArgs
 {
 public:
-   Scalar v[6];
+   cl_int   step, first;
 
-   MandelGeomArgs (const Complex2D& c, const Complex2D& sr) // complex plane origin+resolution specified using centre, semi-radii and pixel definition
-   {
-      v[0]= c.r-sr.r; v[1]= c.i-sr.i; // convert to lower bound
-      v[2]= 2 * sr.r; v[3]= 2 * sr.i; // convert to width (semi-diameters)
-   } // MandelGeomArgs
+   ProgressiveGeomArgs (const Complex2D& c, const Complex2D& sr) : MandelGeomArgs(c,sr), step{1}, first{1} { ; }
 
-   uint8_t nArgs (void) const override { return(2); }
+   uint8_t nArgs (void) const override { return(4); }
 
-   const Scalar *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
    {
       switch(i)
       {
-         case 1 :
-            if (pR && pD && (pD->x > 1) && (pD->y > 1))
-            {  // convert to resolution
-               pR[0]= v[2] / pD->x;
-               pR[1]= v[3] / pD->y;
-               bytes= 2 * sizeof(v[0]);
-               return(pR);
-            }
-         case 0 :
-            bytes= 2 * sizeof(v[0]);
-            return(v+2*i); // break;
-         default :   bytes= 0; return(NULL);
+         case 2 : bytes= sizeof(step); return(&step);
+         case 3 : bytes= sizeof(first); return(&first);
+         default : return MandelGeomArgs::get(bytes, i, pR, pD);
       }
    } // get
-}; // MandelGeomArgs
+}; // ProgressiveGeomArgs
 
 
-int verify (const CMapImageOCL& m) { return(0); }
+CMapChecksum gCheck;
+
+// Device checksum of map against golden result for view and device (recorded when OCL_GOLDEN_RECORD=1)
+int verify (CMapImageOCL& m, const size_t lws[2], const char view[])
+{
+   char key[48];
+   snprintf(key, sizeof(key), "mandel-%s-%dx%d", view, m.getHost().def.x, m.getHost().def.y);
+   if (!gCheck.create(m, lws)) { return(-1); }
+   return gCheck.verify(m, key);
+} // verify
+
+// Floating point operations of a Mandelbrot map: 10 per iteration (square, add, magnitude) and 4 per pixel (coordinates)
+double mandelFlop (const CMapImage2D& m)
+{
+   const size_t n= m.numElem();
+   double s= 0;
+   for (size_t i=0; i<n; i++) { s+= m.pI[i]; }
+   return(10 * s + 4.0 * n);
+} // mandelFlop
 
 CMapImageOCL img; // global to avoid segment violation
+CEnergyMeter gEnergy;
 Def2D gDef={512,512};
 //const ExtArgs dmapEA(Coord2D(128,128));
 const MandelGeomArgs mandelGA(Complex2D(-0.909, -0.275), Complex2D(0.3,0.3));
 //const MandelGeomArgs mandelGA(Complex2D(-0.8,0), Complex2D(1.3,1.3));
+ProgressiveGeomArgs progGA(Complex2D(-0.909, -0.275), Complex2D(0.3,0.3));
 
+#define PROG_STEP_MAX 8 // coarsest pass 1/8 resolution
+
+// Coarse to fine passes (1/8, 1/4, 1/2, full) each leaving a complete image on the host.
+// Only the grid of each pass is read back (1/s^2 of the map), then expanded into blocks.
+// Returns progressive/single pass time ratio, or 0 on failure
+float progressive (size_t lws[2], const MapElement *pRef, const TimeValF tRef)
+{
+   TimeValF t[3], tt=0, tF=0;
+   const CMapImage2D& h= img.getHost();
+   const size_t n= h.numElem();
+   MapElement *pS= new MapElement[n]; // pass samples
+   char name[16];
+   bool ok;
+
+   ok= img.select("progressive"); // same program, no rebuild
+   if (ok) { std::cout << "progressive:" << std::endl; }
+   for (int s= PROG_STEP_MAX; ok && (s > 0); s>>= 1)
+   {
+      const size_t gw= (h.def.x + s - 1) / s, gh= (h.def.y + s - 1) / s;
+      progGA.step= s;
+      progGA.first= (PROG_STEP_MAX == s);
+      img.setItemSize(s,s);
+      img.elapsed();
+      ok= img.execute(lws, progGA, t, false) && img.read(pS, gw * gh);
+      if (ok)
+      {
+         for (size_t gy=0; gy < gh; gy++)
+         {
+            for (size_t gx=0; gx < gw; gx++)
+            {
+               const size_t x0= gx * s, y0= gy * s;
+               if (!progGA.first && (0 == ((x0 | y0) & s))) { continue; } // done by coarser pass
+               const MapElement v= pS[gy * gw + gx];
+               for (size_t y= y0; y < std::min<size_t>(y0 + s, h.def.y); y++)
+               {
+                  for (size_t x= x0; x < std::min<size_t>(x0 + s, h.def.x); x++) { h.pI[h.index(x,y)]= v; }
+               }
+            }
+         }
+         t[2]= img.elapsed(); // read & expand
+         tt+= t[1] + t[2];
+         if (progGA.first) { tF= tt; }
+         std::cout << "\t1/" << s << ": kernel " << t[1] << "sec, read " << t[2] << "sec (" << gw * gh << " elements), cumulative " << tt << "sec" << std::endl;
+         snprintf(name, sizeof(name), "prog%d.raw", s);
+         img.save(name);
+      }
+   }
+   img.setItemSize(1,1);
+   delete [] pS;
+   if (!ok) { return(0); }
+   size_t mis= 0;
+   for (size_t i=0; i<n; i++) { mis+= (pRef[i] != h.pI[i]); }
+   std::cout << "\tfirst image " << tRef / tF << "x sooner, total/single pass " << tt / tRef << ", mismatch " << mis << "pix" << std::endl;
+   return(tt / tRef);
+} // progressive
+
+
+// Energy of phases in t[] (intervals from iE), then per frame over repeated frames
+void energy (size_t lws[2], const TimeValF t[5], const uint32_t iE)
+{
+   const char *phase[]= { "context", "build", "args", "kernel", "buffer-out" };
+   const double flop= mandelFlop(img.getHost());
+   EnergyValF j;
+   TimeValF tf;
+
+   std::cout << "energy (" << gEnergy.name() << ", " << gEnergy.channels() << " channels):" << std::endl;
+   for (int i=0; i<5; i++) { energyReport(phase[i], gEnergy.joules(iE+i), t[i], 1, (3 == i) ? flop : 0); }
+   img.pSink= NULL; // single sample over all frames
+   uint32_t n= energyFrames(gEnergy, [&](){ img.execute(lws, mandelGA); }, j, tf);
+   energyReport("frames", j, tf, n, flop);
+   img.pSink= &gEnergy;
+} // energy
 
 //const KernInfo idx(idxImgSrc);
 //const KernInfo dmap(dmapImgSrc, &dmapEA);
@@ -94,33 +166,48 @@ int main (int argc, char *argv[])
    cl_device_id   idDev[MAX_DEV_ID]={0,};
    cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
    int r=-1;
+   uint32_t iE= 0;
 
+   if (gEnergy.open()) { img.pSink= &gEnergy; iE= gEnergy.count(); }
    if (nDev > 0)
    {
       //CImageOCL img; // destruction causes segment violation inside clReleaseContext()
       TimeValF t[5];
       size_t lws[2]={32,32};
 
-      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y,CL_MEM_READ_WRITE|CL_MEM_HOST_READ_ONLY)) // device readable for checksum
       {
          const KernInfo *pK= &mandel;
 
+         if (!img.fitLWS(lws)) { std::cout << "local work size reduced to " << lws[0] << "x" << lws[1] << std::endl; }
+
          t[0]= img.elapsed();
          std::cout << "context created: " << t[0] << "sec" << std::endl;
 
-         if (img.defaultBuild(pK->src,pK->entryPoint))
+         const char *src[]= { pK->src, progKernSrc };
+
+         if (img.defaultBuild(src, 2, pK->entryPoint))
          {
             t[1]= img.elapsed();
             std::cout << "build OK: " << t[1] << "sec" << std::endl;
 
             if (img.execute(lws, *(pK->pA), t+2))
             {
-               r= verify(img);
+               r= verify(img, lws, "v0");
                std::cout << "execution: r=" << r << std::endl;
                std::cout << "\targs:       " << t[2] << "sec"  << std::endl;
                std::cout << "\tkernel:     " << t[3] << "sec"  << std::endl;
                std::cout << "\tbuffer-out: " << t[4] << "sec"  << std::endl;
                img.save("img.raw");
+               if (gEnergy.valid()) { energy(lws, t, iE); }
+               if ((argc > 1) && (0 == strcmp(argv[1], "-p")))
+               {  // keep single pass result for comparison
+                  const size_t n= img.getHost().numElem();
+                  MapElement *pRef= new MapElement[n];
+                  memcpy(pRef, img.getHost().pI, n * sizeof(*pRef));
+                  if (progressive(lws, pRef, t[3] + t[4]) <= 0) { r= -1; }
+                  delete [] pRef;
+               }
             }
          }
          else { img.reportBuildLog(); std::cout << pK->src; }
@@ -0,0 +1,336 @@
+// ocl4.cpp - Deep zoom Mandelbrot set: precision tiers.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <cmath>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+// Precision tiers, in order of increasing zoom depth
+enum MandelTier { MT_FLOAT, MT_DOUBLE, MT_DF, MT_PERTURB, MT_COUNT };
+
+const char *tierName[MT_COUNT]= { "float", "double", "double-float", "perturbation" };
+
+
+/* OpenCL kernel sources, assembled per tier from the source table */
+
+const char mandDefsSrc[]=
+"#pragma OPENCL FP_CONTRACT OFF\n" \
+"#define BAILOUT_M2 1E12f\n" \
+"#define GLITCH_TOL 1E-6f\n";
+
+const char realFloatSrc[]=
+"typedef float real; typedef float2 real2;\n";
+
+const char realDoubleSrc[]=
+"#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n" \
+"typedef double real; typedef double2 real2;\n";
+
+// Native precision (float or double) iteration, type defined by prefix source
+const char mandRealSrc[]=
+"int mandel (const real2 c, const int maxI)\n" \
+"{ int i=0; real2 z= c, t;\n" \
+"  do { ++i; t.x= z.x * z.x - z.y * z.y + c.x; t.y= 2 * z.x * z.y + c.y; z= t; }\n" \
+"  while ((dot(z,z) < BAILOUT_M2) && (i < maxI));\n" \
+"  return(i); }\n" \
+"\n" \
+"kernel void image (__global int *pI, const ushort2 def, const real2 c0, const real2 dc, const int maxI)\n" \
+"{ ushort2 u; real2 c;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    c.x= c0.x + dc.x * u.x;\n" \
+"    c.y= c0.y + dc.y * u.y;\n" \
+"    pI[(size_t)u.y * def.x + u.x]= mandel(c, maxI); } }\n";
+
+// Emulated precision: "double-float" value = (hi,lo) pair of floats, ~48bit mantissa
+const char mandDFSrc[]=
+"float2 qts (const float a, const float b) { float s= a + b; return (float2)(s, b - (s - a)); }\n" \
+"float2 ts (const float a, const float b) { float s= a + b; float v= s - a; return (float2)(s, (a - (s - v)) + (b - v)); }\n" \
+"float2 tp (const float a, const float b) { float p= a * b; return (float2)(p, fma(a, b, -p)); }\n" \
+"float2 dfAdd (const float2 a, const float2 b) { float2 s= ts(a.x, b.x); s.y+= a.y + b.y; return qts(s.x, s.y); }\n" \
+"float2 dfMul (const float2 a, const float2 b) { float2 p= tp(a.x, b.x); p.y+= a.x * b.y + a.y * b.x; return qts(p.x, p.y); }\n" \
+"\n" \
+"int mandelDF (const float2 cx, const float2 cy, const int maxI)\n" \
+"{ int i=0; float2 x= cx, y= cy, x2, y2, xy;\n" \
+"  do { ++i;\n" \
+"    x2= dfMul(x,x); y2= dfMul(y,y); xy= dfMul(x,y);\n" \
+"    x= dfAdd(dfAdd(x2, -y2), cx);\n" \
+"    y= dfAdd(dfAdd(xy, xy), cy);\n" \
+"  } while (((x.x * x.x + y.x * y.x) < BAILOUT_M2) && (i < maxI));\n" \
+"  return(i); }\n" \
+"\n" \
+"kernel void image (__global int *pI, const ushort2 def, const float4 c0, const float2 dc, const int maxI)\n" \
+"{ ushort2 u;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    float2 cx= dfAdd(c0.xy, tp(dc.x, u.x));\n" \
+"    float2 cy= dfAdd(c0.zw, tp(dc.y, u.y));\n" \
+"    pI[(size_t)u.y * def.x + u.x]= mandelDF(cx, cy, maxI); } }\n";
+
+// Perturbation about a host computed reference orbit Z[n] at the view centre:
+// d[n+1]= (2 Z[n] + d[n]) d[n] + dC, z[n]= Z[n] + d[n]
+// Pixels that lose precision (glitch) or outlive the reference are marked negative.
+const char mandPertSrc[]=
+"kernel void image (__global int *pI, const ushort2 def, __global const float2 *pZ, const int nZ, const float2 d0, const float2 dc, const int maxI)\n" \
+"{ ushort2 u;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    float2 dC, d, t, z; float m; int i=0, n=1, g=0;\n" \
+"    dC.x= d0.x + dc.x * u.x;\n" \
+"    dC.y= d0.y + dc.y * u.y;\n" \
+"    d= dC;\n" \
+"    do { ++i;\n" \
+"      t= 2 * pZ[n] + d;\n" \
+"      d= (float2)(t.x * d.x - t.y * d.y, t.x * d.y + t.y * d.x) + dC;\n" \
+"      t= pZ[++n]; z= t + d; m= dot(z,z);\n" \
+"      if (m < GLITCH_TOL * dot(t,t)) { g= 1; }\n" \
+"    } while ((0 == g) && (m < BAILOUT_M2) && (i < maxI) && (n < (nZ-1)));\n" \
+"    if ((m < BAILOUT_M2) && (i < maxI)) { g= 1; }\n" \
+"    pI[(size_t)u.y * def.x + u.x]= g ? -i : i; } }\n";
+
+struct TierSrc
+{
+   const char **srcTab;
+   int nSrc;
+}; // TierSrc
+
+const char *srcFloat[]= { mandDefsSrc, realFloatSrc, mandRealSrc };
+const char *srcDouble[]= { mandDefsSrc, realDoubleSrc, mandRealSrc };
+const char *srcDF[]= { mandDefsSrc, mandDFSrc };
+const char *srcPert[]= { mandDefsSrc, mandPertSrc };
+
+const TierSrc tierSrc[MT_COUNT]= { {srcFloat,3}, {srcDouble,3}, {srcDF,2}, {srcPert,2} };
+
+// View of complex plane, long double precision sufficient for centre of deep zoom
+// (64bit mantissa on x86, 113bit on AArch64)
+struct DeepView
+{
+   long double cr, ci, sr;
+
+   DeepView (long double r, long double i, long double s) : cr{r}, ci{i}, sr{s} { ; }
+
+   // more iterations needed to resolve detail as zoom deepens
+   int maxIter (void) const { return(256 + 64 * std::max<int>(0, log2l(1 / sr))); }
+
+   // pixel spacing relative to magnitude of coordinates: the precision demand
+   long double relRes (const Def2D& def) const
+   {
+      long double m= std::max(fabsl(cr), fabsl(ci)) + sr;
+      return((2 * sr) / (std::max(def.x, def.y) * m));
+   } // relRes
+}; // DeepView
+
+// Choose cheapest tier that leaves a few bits of sub-pixel precision
+MandelTier selectTier (const DeepView& v, const Def2D& def, bool fp64)
+{
+   long double r= v.relRes(def);
+   if (r > ldexpl(1,-18)) { return(MT_FLOAT); }
+   if (fp64 && (r > ldexpl(1,-46))) { return(MT_DOUBLE); }
+   if (r > ldexpl(1,-40)) { return(MT_DF); }
+   return(MT_PERTURB);
+} // selectTier
+
+class DeepMandelArgs : public GeomArgs
+{
+protected:
+   // Reference orbit from view centre, computed in long double and stored as float
+   bool createOrbit (const DeepView& v, cl_context ctx)
+   {
+      cl_int r;
+      const int maxZ= maxI + 2;
+      cl_float2 *pZ= new cl_float2[maxZ];
+      long double zr=0, zi=0, t;
+
+      nZ= 0;
+      do
+      {
+         pZ[nZ].x= zr; pZ[nZ].y= zi;
+         t= zr * zr - zi * zi + v.cr;
+         zi= 2 * zr * zi + v.ci;
+         zr= t;
+      } while ((++nZ < maxZ) && ((pZ[nZ-1].x * pZ[nZ-1].x + pZ[nZ-1].y * pZ[nZ-1].y) < 1E12));
+      hZ= clCreateBuffer(ctx, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, nZ * sizeof(*pZ), pZ, &r);
+      delete [] pZ;
+      return(r >= 0);
+   } // createOrbit
+
+public:
+   MandelTier  tier;
+   cl_int      maxI, nZ;
+   cl_float    f[6];    // float, double-float & perturbation parameters
+   cl_double   d[4];    // native double parameters
+   cl_mem      hZ;      // reference orbit (perturbation only)
+
+   DeepMandelArgs (void) : tier{MT_FLOAT}, maxI{256}, nZ{0}, hZ{0} { ; }
+   ~DeepMandelArgs () { release(); }
+
+   bool setup (MandelTier t, const DeepView& v, const Def2D& def, cl_context ctx)
+   {
+      const long double c0r= v.cr - v.sr, c0i= v.ci - v.sr; // lower bound
+      const long double dr= 2 * v.sr / def.x, di= 2 * v.sr / def.y; // resolution
+
+      release();
+      tier= t;
+      maxI= v.maxIter();
+      switch(tier)
+      {
+         case MT_FLOAT :
+            f[0]= c0r; f[1]= c0i; f[2]= dr; f[3]= di;
+            break;
+         case MT_DOUBLE :
+            d[0]= c0r; d[1]= c0i; d[2]= dr; d[3]= di;
+            break;
+         case MT_DF :   // split into hi,lo pairs
+            f[0]= c0r; f[1]= c0r - f[0];
+            f[2]= c0i; f[3]= c0i - f[2];
+            f[4]= dr; f[5]= di;
+            break;
+         case MT_PERTURB :
+            f[0]= -v.sr; f[1]= -v.sr; f[2]= dr; f[3]= di;
+            return createOrbit(v, ctx);
+         default : return(false);
+      }
+      return(true);
+   } // setup
+
+   uint8_t nArgs (void) const override { return((MT_PERTURB == tier) ? 5 : 3); }
+
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   {
+      if (MT_PERTURB == tier)
+      {
+         switch(i)
+         {
+            case 0 : bytes= sizeof(hZ); return(&hZ);
+            case 1 : bytes= sizeof(nZ); return(&nZ);
+            case 2 : bytes= 2 * sizeof(f[0]); return(f+0);
+            case 3 : bytes= 2 * sizeof(f[0]); return(f+2);
+         }
+      }
+      else
+      {
+         switch(i)
+         {
+            case 0 :
+               if (MT_DOUBLE == tier) { bytes= 2 * sizeof(d[0]); return(d+0); }
+               bytes= ((MT_DF == tier) ? 4 : 2) * sizeof(f[0]); return(f+0);
+            case 1 :
+               if (MT_DOUBLE == tier) { bytes= 2 * sizeof(d[0]); return(d+2); }
+               bytes= 2 * sizeof(f[0]); return(f + ((MT_DF == tier) ? 4 : 2));
+         }
+      }
+      if (i == (nArgs()-1)) { bytes= sizeof(maxI); return(&maxI); }
+      //else
+      bytes= 0; return(NULL);
+   } // get
+
+   bool release (void)
+   {
+      cl_int r=0;
+      if (0 != hZ) { r= clReleaseMemObject(hZ); hZ= 0; }
+      nZ= 0;
+      return(r >= 0);
+   } // release
+}; // DeepMandelArgs
+
+// Total iterations (glitched pixels included) for throughput estimate
+size_t sumIter (const HostArgs& h, size_t *pG=NULL)
+{
+   size_t s=0, g=0;
+   const size_t n= h.numElem();
+   for (size_t i=0; i<n; i++)
+   {
+      MapElement v= h.pI[i];
+      if (v < 0) { ++g; v= -v; }
+      s+= v;
+   }
+   if (pG) { *pG= g; }
+   return(s);
+} // sumIter
+
+CMapImageOCL img; // global to avoid segment violation
+DeepMandelArgs deepGA;
+Def2D gDef={512,512};
+
+// Successive zoom into "seahorse valley"
+const DeepView gView[]=
+{
+   DeepView(-0.743643887037158704752191506114774L, 0.131825904205311970493132056385139L, 3E-1L),
+   DeepView(-0.743643887037158704752191506114774L, 0.131825904205311970493132056385139L, 1E-5L),
+   DeepView(-0.743643887037158704752191506114774L, 0.131825904205311970493132056385139L, 1E-9L),
+   DeepView(-0.743643887037158704752191506114774L, 0.131825904205311970493132056385139L, 1E-13L),
+   DeepView(-0.743643887037158704752191506114774L, 0.131825904205311970493132056385139L, 1E-17L)
+};
+const int nView= sizeof(gView) / sizeof(gView[0]);
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      TimeValF t[5];
+      size_t lws[2]={32,32};
+      MandelTier sel[nView];
+      const bool fp64= deviceProfile(idDev[0]).fp64;
+
+      std::cout << "cl_khr_fp64: " << fp64 << std::endl;
+      for (int v=0; v<nView; v++)
+      {
+         sel[v]= selectTier(gView[v], gDef, fp64);
+         std::cout << "view " << v << ": semi-radius=" << (double)gView[v].sr << " iterations=" << gView[v].maxIter();
+         std::cout << " -> " << tierName[sel[v]] << std::endl;
+      }
+
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      {
+         t[0]= img.elapsed();
+         std::cout << "context created: " << t[0] << "sec" << std::endl;
+         r= 0;
+         for (int iT=0; iT < MT_COUNT; iT++)
+         {
+            if ((MT_DOUBLE == iT) && !fp64) { continue; }
+            if (img.defaultBuild(tierSrc[iT].srcTab, tierSrc[iT].nSrc, "image"))
+            {
+               t[1]= img.elapsed();
+               std::cout << tierName[iT] << " build OK: " << t[1] << "sec" << std::endl;
+
+               for (int v=0; v<nView; v++)
+               {
+                  if (deepGA.setup((MandelTier)iT, gView[v], gDef, img.ctx) && img.execute(lws, deepGA, t+2))
+                  {
+                     size_t g, s= sumIter(img.getHost(), &g);
+                     std::cout << tierName[iT] << " view " << v << ":" << std::endl;
+                     std::cout << "\tkernel:     " << t[3] << "sec"  << std::endl;
+                     std::cout << "\tthroughput: " << 1E-6 * img.getHost().numElem() / t[3] << "Mpix/s, ";
+                     std::cout << 1E-6 * s / t[3] << "Miter/s" << std::endl;
+                     if (g > 0) { std::cout << "\tglitched:   " << g << "pix" << std::endl; }
+                     if (sel[v] == iT)
+                     {
+                        char name[]="deep#.raw";
+                        name[4]= '0' + v;
+                        img.save(name);
+                     }
+                  }
+                  else { r= -1; }
+               }
+            }
+            else { img.reportBuildLog(); r= -1; }
+         }
+      }
+   }
+   return(r);
+} // main
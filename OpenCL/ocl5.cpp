@@ -0,0 +1,284 @@
+// ocl5.cpp - Reduced precision (half / fixed point) map kernels.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <cmath>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+// Precision variants: float is the reference for accuracy comparison
+enum PrecVar { PV_FLOAT, PV_HALF, PV_FIXED, PV_COUNT };
+
+const char *pvName[PV_COUNT]= { "float", "half", "fixed" };
+
+
+/* OpenCL kernel sources */
+
+const char realFloatSrc[]=
+"typedef float real; typedef float2 real2;\n" \
+"#define CVT_REAL2 convert_float2\n";
+
+const char realHalfSrc[]=
+"#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n" \
+"typedef half real; typedef half2 real2;\n" \
+"#define CVT_REAL2 convert_half2\n";
+
+// Distance map of circle, differences scaled to keep squares within half range
+const char dmapRealSrc[]=
+"#define DMAP_SCALE 128\n" \
+"kernel void image (__global int *pI, const ushort2 def, const float2 c, const float r)\n" \
+"{ ushort2 u;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    real2 d= (CVT_REAL2(u) - CVT_REAL2(c)) * (real)(1.0f / DMAP_SCALE);\n" \
+"    real s= length(d) * (real)DMAP_SCALE - (real)r;\n" \
+"    pI[(size_t)u.y * def.x + u.x]= s; } }\n";
+
+// Distance map using 1/16 pixel fixed point and integer square root.
+// Squares fit 32bits for definition up to 2048.
+const char dmapFixedSrc[]=
+"#define FXD 4\n" \
+"uint isqrt (uint v)\n" \
+"{ uint r=0, b= 1U << 30;\n" \
+"  while (b > v) { b>>= 2; }\n" \
+"  while (b) { if (v >= r + b) { v-= r + b; r= (r >> 1) + b; } else { r>>= 1; } b>>= 2; }\n" \
+"  return(r); }\n" \
+"\n" \
+"kernel void image (__global int *pI, const ushort2 def, const int2 c, const int r)\n" \
+"{ ushort2 u;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    int2 d= (convert_int2(u) << FXD) - c;\n" \
+"    uint m= (uint)(d.x * d.x) + (uint)(d.y * d.y);\n" \
+"    int s= (int)isqrt(m) - r;\n" \
+"    pI[(size_t)u.y * def.x + u.x]= s / (1 << FXD); } }\n";
+
+// Mandelbrot with escape radius 2 so that fixed point range suffices
+const char mandRealSrc[]=
+"int mandel (const real2 c, const int maxI)\n" \
+"{ int i=0; real2 z= c; real x2= z.x * z.x, y2= z.y * z.y;\n" \
+"  while (((x2 + y2) < (real)4) && (i < maxI))\n" \
+"  { ++i; z.y= 2 * z.x * z.y + c.y; z.x= x2 - y2 + c.x; x2= z.x * z.x; y2= z.y * z.y; }\n" \
+"  return(i); }\n" \
+"\n" \
+"kernel void image (__global int *pI, const ushort2 def, const float2 c0, const float2 dc, const int maxI)\n" \
+"{ ushort2 u;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    pI[(size_t)u.y * def.x + u.x]= mandel(CVT_REAL2(c0 + dc * convert_float2(u)), maxI); } }\n";
+
+// Mandelbrot in Q6.25 fixed point: 32bit integer operations only (no 64bit
+// integer support needed, as permitted by embedded profile).
+// |z| < 2 is checked before each update so squares remain < 64
+const char mandFixedSrc[]=
+"#define FXQ 25\n" \
+"int fxMul (const int a, const int b) { return((mul_hi(a,b) << (32-FXQ)) | (((uint)a * (uint)b) >> FXQ)); }\n" \
+"\n" \
+"int mandel (const int2 c, const int maxI)\n" \
+"{ int i=0; int2 z= c; int x2= fxMul(z.x,z.x), y2= fxMul(z.y,z.y);\n" \
+"  while ((((uint)x2 + (uint)y2) < (4U << FXQ)) && (i < maxI))\n" \
+"  { ++i; z.y= 2 * fxMul(z.x,z.y) + c.y; z.x= x2 - y2 + c.x; x2= fxMul(z.x,z.x); y2= fxMul(z.y,z.y); }\n" \
+"  return(i); }\n" \
+"\n" \
+"kernel void image (__global int *pI, const ushort2 def, const int2 c0, const int2 dc, const int maxI)\n" \
+"{ ushort2 u;\n" \
+"  u.x= get_global_id(0); u.y= get_global_id(1);\n" \
+"  if ((u.x < def.x) && (u.y < def.y)) {\n" \
+"    pI[(size_t)u.y * def.x + u.x]= mandel(c0 + dc * convert_int2(u), maxI); } }\n";
+
+#define DMAP_FXD  4
+#define MAND_FXQ  25
+
+// Convert to fixed point, rounding to nearest
+cl_int toFixed (double v, int q) { return(floor(ldexp(v,q) + 0.5)); }
+
+// Arguments prepared for each precision variant
+class PrecGeomArgs : public GeomArgs
+{
+public:
+   PrecVar var;
+
+   PrecGeomArgs (void) : var{PV_FLOAT} { ; }
+
+   void setVar (PrecVar v) { var= v; }
+}; // PrecGeomArgs
+
+class DMapPrecArgs : public PrecGeomArgs
+{
+public:
+   Scalar   v[3];
+   cl_int   q[3];
+
+   DMapPrecArgs (const Coord2D& c, Scalar r)
+   {
+      v[0]= c.x; v[1]= c.y; v[2]= r;
+      for (int i=0; i<3; i++) { q[i]= toFixed(v[i], DMAP_FXD); }
+   }
+
+   uint8_t nArgs (void) const override { return(2); }
+
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   {
+      const bool fx= (PV_FIXED == var);
+      switch(i)
+      {
+         case 0 :    bytes= 2 * sizeof(v[0]); return(fx ? (const void*)q : v); // break;
+         case 1 :    bytes= sizeof(v[2]); return(fx ? (const void*)(q+2) : (v+2)); // break;
+         default :   bytes= 0; return(NULL);
+      }
+   }
+}; // DMapPrecArgs
+
+class MandelPrecArgs : public PrecGeomArgs
+{
+public:
+   Scalar   v[4];
+   cl_int   q[4], maxI;
+
+   MandelPrecArgs (const Complex2D& c, const Complex2D& sr, const Def2D& def, int mi=256)
+   {
+      v[0]= c.r-sr.r; v[1]= c.i-sr.i; // convert to lower bound
+      v[2]= 2 * sr.r / def.x; v[3]= 2 * sr.i / def.y; // convert to resolution
+      for (int i=0; i<4; i++) { q[i]= toFixed(v[i], MAND_FXQ); }
+      maxI= mi;
+   } // MandelPrecArgs
+
+   uint8_t nArgs (void) const override { return(3); }
+
+   const void *get (size_t& bytes, uint8_t i, Scalar *pR=NULL, const Def2D *pD=NULL) const override
+   {
+      const bool fx= (PV_FIXED == var);
+      switch(i)
+      {
+         case 0 :
+         case 1 :    bytes= 2 * sizeof(v[0]); return(fx ? (const void*)(q+2*i) : (v+2*i)); // break;
+         case 2 :    bytes= sizeof(maxI); return(&maxI);
+         default :   bytes= 0; return(NULL);
+      }
+   }
+}; // MandelPrecArgs
+
+struct PrecWorkload
+{
+   const char     *name;
+   const char     *src[PV_COUNT][2];
+   PrecGeomArgs   *pA;
+   int            maxErr;  // acceptance tolerance: max abs error
+   float          maxMis;  // and mismatched pixel fraction
+}; // PrecWorkload
+
+// Accuracy relative to reference
+struct AccRep
+{
+   int      maxErr;
+   size_t   mis;
+
+   AccRep (void) : maxErr{0}, mis{0} { ; }
+
+   void compare (const MapElement m[], const MapElement ref[], const size_t n)
+   {
+      maxErr= 0; mis= 0;
+      for (size_t i=0; i<n; i++)
+      {
+         int e= abs(m[i] - ref[i]);
+         if (e > 0) { mis++; if (e > maxErr) { maxErr= e; } }
+      }
+   } // compare
+}; // AccRep
+
+
+/***/
+Def2D gDef={512,512};
+
+DMapPrecArgs dmapGA(Coord2D(0.5*gDef.x,0.5*gDef.y),0.125*(gDef.x+gDef.y));
+MandelPrecArgs mandelGA(Complex2D(-0.909, -0.275), Complex2D(0.3,0.3), gDef);
+
+PrecWorkload gWL[]=
+{
+   { "distance", { {realFloatSrc,dmapRealSrc}, {realHalfSrc,dmapRealSrc}, {dmapFixedSrc,NULL} }, &dmapGA, 1, 1.0 },
+   { "mandelbrot", { {realFloatSrc,mandRealSrc}, {realHalfSrc,mandRealSrc}, {mandFixedSrc,NULL} }, &mandelGA, 256, 0.05 }
+};
+const int nWL= sizeof(gWL) / sizeof(gWL[0]);
+
+CMapImageOCL img; // global to avoid segment violation
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      TimeValF t[5];
+      size_t lws[2]={32,32};
+      const bool fp16= deviceProfile(idDev[0]).fp16;
+
+      std::cout << "cl_khr_fp16: " << fp16 << std::endl;
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      {
+         const size_t n= img.getHost().numElem();
+         MapElement *pRef= new MapElement[n];
+
+         r= 0;
+         for (int iW=0; iW < nWL; iW++)
+         {
+            PrecWorkload& w= gWL[iW];
+            TimeValF tk[PV_COUNT];
+            int sel= PV_FLOAT;
+
+            for (int iV=0; iV < PV_COUNT; iV++)
+            {
+               tk[iV]= 0;
+               if ((PV_HALF == iV) && !fp16) { continue; }
+               const int nSrc= w.src[iV][1] ? 2 : 1;
+               if (img.defaultBuild(w.src[iV], nSrc, "image"))
+               {
+                  w.pA->setVar((PrecVar)iV);
+                  for (int k=0; k<3; k++) // best of 3
+                  {
+                     if (img.execute(lws, *(w.pA), t))
+                     {
+                        if ((0 == tk[iV]) || (t[1] < tk[iV])) { tk[iV]= t[1]; }
+                     }
+                  }
+                  if (0 == tk[iV])
+                  {  // no execute succeeded: nothing to time or compare
+                     std::cout << w.name << " " << pvName[iV] << ": execute failed" << std::endl;
+                     r= -1;
+                     if (PV_FLOAT == iV) { break; } // no reference
+                     continue;
+                  }
+                  std::cout << w.name << " " << pvName[iV] << ":" << std::endl;
+                  std::cout << "\tkernel:     " << tk[iV] << "sec, " << 1E-6 * n / tk[iV] << "Mpix/s" << std::endl;
+                  if (PV_FLOAT == iV) { memcpy(pRef, img.getHost().pI, n * sizeof(*pRef)); }
+                  else
+                  {
+                     AccRep a;
+                     a.compare(img.getHost().pI, pRef, n);
+                     std::cout << "\taccuracy:   max error=" << a.maxErr << " mismatch=" << a.mis << "pix (" << 100.0 * a.mis / n << "%)" << std::endl;
+                     std::cout << "\tspeedup:    " << tk[PV_FLOAT] / tk[iV] << std::endl;
+                     if ((a.maxErr <= w.maxErr) && (a.mis <= w.maxMis * n) && (tk[iV] < tk[sel])) { sel= iV; }
+                  }
+               }
+               else { img.reportBuildLog(); r= -1; }
+            }
+            if (tk[PV_FLOAT] > 0) { std::cout << w.name << " selected: " << pvName[sel] << std::endl; }
+         }
+         delete [] pRef;
+      }
+   }
+   return(r);
+} // main
@@ -0,0 +1,190 @@
+// ocl6.cpp - Explicitly vectorised (multi-pixel per work item) map kernels.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <cstdio>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+// Vector widths tested, 1 -> scalar kernel
+const int vecWidth[]= { 1, 4, 8, 16 };
+const int nVecWidth= sizeof(vecWidth) / sizeof(vecWidth[0]);
+
+
+/* OpenCL kernel sources */
+
+// Vector variants: lane types & helpers defined by generated prefix (see vecPrefix)
+const char vecStoreSrc[]=
+"void storeV (const intv v, __global int *p, const size_t n)\n" \
+"{ if (n >= VW) { VSTORE(v, 0, p); }\n" \
+"  else { int t[VW]; VSTORE(v, 0, t); for (size_t i=0; i<n; i++) { p[i]= t[i]; } } }\n\n";
+
+const char dmapVecSrc[]=
+"kernel void image (__global int *pI, const ushort2 def, const float2 c, const float r)\n" \
+"{ size_t x0= get_global_id(0) * VW, y= get_global_id(1);\n" \
+"  if ((x0 < def.x) && (y < def.y)) {\n" \
+"    floatv dx= LANE_OFS + ((float)x0 - c.x);\n" \
+"    float dy= y - c.y;\n" \
+"    intv s= CONVERT_INTV(sqrt(dx * dx + dy * dy) - r);\n" \
+"    storeV(s, pI + y * def.x + x0, def.x - x0); } }\n";
+
+// Escape mask: lanes remain active (-1) until their orbit escapes, iteration
+// continues until all lanes inactive or limit reached
+const char mandelVecSrc[]=
+"kernel void image (__global int *pI, const ushort2 def, const float2 c0, const float2 dc)\n" \
+"{ size_t x0= get_global_id(0) * VW, y= get_global_id(1);\n" \
+"  if ((x0 < def.x) && (y < def.y)) {\n" \
+"    floatv cx= c0.x + dc.x * (LANE_OFS + (float)x0);\n" \
+"    floatv cy= (floatv)(c0.y + dc.y * y);\n" \
+"    floatv zx= cx, zy= cy, t;\n" \
+"    intv n= (intv)(0), a= (intv)(-1);\n" \
+"    int i=0;\n" \
+"    do { ++i;\n" \
+"      t= zx * zx - zy * zy + cx;\n" \
+"      zy= 2 * zx * zy + cy;\n" \
+"      zx= t;\n" \
+"      n-= a;\n" \
+"      a&= isless(zx * zx + zy * zy, (floatv)(1E12f));\n" \
+"    } while (any(a) && (i < 256));\n" \
+"    storeV(n, pI + y * def.x + x0, def.x - x0); } }\n";
+
+// Generate type & helper definitions for vector width w (4, 8 or 16)
+int vecPrefix (char s[], const int max, const int w)
+{
+   int n= snprintf(s, max, "#define VW %d\ntypedef float%d floatv; typedef int%d intv;\n" \
+               "#define CONVERT_INTV convert_int%d\n#define VSTORE vstore%d\n#define LANE_OFS (float%d)(0", w, w, w, w, w, w);
+   for (int i=1; (i<w) && (n < max); i++) { n+= snprintf(s+n, max-n, ",%d", i); }
+   if (n < max) { n+= snprintf(s+n, max-n, ")\n"); }
+   return(n);
+} // vecPrefix
+
+struct VecWorkload
+{
+   const char  *name, *scalarSrc, *vecSrc; // scalar original (KernSrcOCL.hpp) & vector variant
+   GeomArgs    *pA;
+}; // VecWorkload
+
+
+/***/
+Def2D gDef={512,512};
+
+DMapGeomArgs dmapGA(Coord2D(0.5*gDef.x,0.5*gDef.y),0.125*(gDef.x+gDef.y));
+MandelGeomArgs mandelGA(Complex2D(-0.909, -0.275), Complex2D(0.3,0.3));
+
+VecWorkload gWL[]=
+{
+   { "distance", dmapKernSrc, dmapVecSrc, &dmapGA },
+   { "mandelbrot", mandelKernSrc, mandelVecSrc, &mandelGA }
+};
+const int nWL= sizeof(gWL) / sizeof(gWL[0]);
+
+CMapImageOCL img; // global to avoid segment violation
+
+// Build workload iW at vector width w (1 -> scalar original)
+bool buildVariant (const int iW, const int w)
+{
+   if (w > 1)
+   {
+      char pfx[256];
+      const char *src[]= { pfx, vecStoreSrc, gWL[iW].vecSrc };
+      vecPrefix(pfx, sizeof(pfx), w);
+      return img.defaultBuild(src, 3, "image");
+   }
+   return img.defaultBuild(gWL[iW].scalarSrc, "image");
+} // buildVariant
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      TimeValF t[5];
+      size_t lws[2]={32,32};
+      const cl_uint pvw= std::max<cl_uint>(1, deviceProfile(idDev[0]).vecFloat);
+      int selW= 1; // scalar unless device prefers vectors
+
+      for (int i=1; i<nVecWidth; i++) { if (pvw >= (cl_uint)vecWidth[i]) { selW= vecWidth[i]; } }
+      std::cout << "preferred float vector width: " << pvw << " -> " << selW << std::endl;
+
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      {
+         const size_t n= img.getHost().numElem();
+         MapElement *pRef= new MapElement[n];
+
+         r= 0;
+         for (int iW=0; iW < nWL; iW++)
+         {
+            TimeValF tk[nVecWidth];
+            int best= 0;
+
+            for (int iV=0; iV < nVecWidth; iV++)
+            {
+               const int w= vecWidth[iV];
+
+               tk[iV]= 0;
+               if (buildVariant(iW, w))
+               {
+                  img.setItemWidth(w);
+                  for (int k=0; k<3; k++) // best of 3
+                  {
+                     if (img.execute(lws, *(gWL[iW].pA), t))
+                     {
+                        if ((0 == tk[iV]) || (t[1] < tk[iV])) { tk[iV]= t[1]; }
+                     }
+                  }
+                  std::cout << gWL[iW].name << " width " << w << ":" << std::endl;
+                  std::cout << "\tkernel:     " << tk[iV] << "sec, " << 1E-6 * n / tk[iV] << "Mpix/s" << std::endl;
+                  if (1 == w) { memcpy(pRef, img.getHost().pI, n * sizeof(*pRef)); }
+                  else
+                  {
+                     size_t mis= 0;
+                     for (size_t i=0; i<n; i++) { mis+= (pRef[i] != img.getHost().pI[i]); }
+                     std::cout << "\tmismatch:   " << mis << "pix" << std::endl;
+                     std::cout << "\tspeedup:    " << tk[0] / tk[iV] << std::endl;
+                     if (tk[iV] < tk[best]) { best= iV; }
+                  }
+               }
+               else { img.reportBuildLog(); r= -1; }
+            }
+            std::cout << gWL[iW].name << " fastest width: " << vecWidth[best] << " (selected " << selW << ")" << std::endl;
+
+            // Production run: the device preferred width decides the kernel, sweep above is comparison only
+            if (buildVariant(iW, selW))
+            {
+               char name[32];
+
+               img.setItemWidth(selW);
+               if (img.execute(lws, *(gWL[iW].pA), t))
+               {
+                  size_t mis= 0;
+                  for (size_t i=0; i<n; i++) { mis+= (pRef[i] != img.getHost().pI[i]); }
+                  std::cout << gWL[iW].name << " production width " << selW << ": " << t[1] << "sec, mismatch " << mis << "pix" << std::endl;
+                  snprintf(name, sizeof(name), "%s.raw", gWL[iW].name);
+                  img.save(name);
+               }
+               else { r= -1; }
+            }
+            else { img.reportBuildLog(); r= -1; }
+         }
+         img.setItemWidth(1);
+         delete [] pRef;
+      }
+   }
+   return(r);
+} // main
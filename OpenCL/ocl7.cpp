@@ -0,0 +1,127 @@
+// ocl7.cpp - Distance map of many primitives: tile binning vs naive evaluation.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <cstdlib>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/PrimMapOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+// Naive evaluation is O(pixels x primitives): skip beyond this count
+#define NAIVE_MAX_PRIM  10000
+
+const int primCount[]= { 1, 10, 100, 1000, 10000, 100000 };
+const int nPrimCount= sizeof(primCount) / sizeof(primCount[0]);
+
+float frand (float a, float b) { return(a + (b - a) * rand() / (float)RAND_MAX); }
+
+// Random mix of circles, segments & boxes scattered over map, scaled to count
+void genPrim (DMapPrim p[], const int n, const Def2D& def)
+{
+   const float s= 0.5 * std::min(def.x, def.y) / sqrtf(n);
+   for (int i=0; i<n; i++)
+   {
+      const float x= frand(0,def.x), y= frand(0,def.y), r= frand(0.1,0.4) * s + 1;
+      switch(i % 3)
+      {
+         case PT_CIRCLE :  p[i]= DMapPrim::circle(x, y, r); break;
+         case PT_SEGMENT : p[i]= DMapPrim::segment(x, y, x + frand(-s,s), y + frand(-s,s) + 1, 0.25 * r); break;
+         case PT_BOX :     p[i]= DMapPrim::box(x, y, r, frand(0.5,1) * r); break;
+      }
+   }
+} // genPrim
+
+/***/
+Def2D gDef={512,512};
+
+CMapImageOCL img; // global to avoid segment violation
+PrimMapArgs primGA;
+CPrimBins bins;
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      TimeValF t[5], tn[nPrimCount]={0,};
+      size_t lws[2]={PRIM_TILE,PRIM_TILE};
+
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      {
+         const size_t n= img.getHost().numElem();
+         const int maxP= primCount[nPrimCount-1];
+         DMapPrim *pP= new DMapPrim[maxP];
+         MapElement *pRef= new MapElement[nPrimCount * n];
+
+         srand(1);
+         genPrim(pP, maxP, gDef); // subsets share leading primitives
+         r= 0;
+         for (int binned=0; binned<2; binned++)
+         {
+            const char *src[]= { primSDFSrc, binned ? primBinnedSrc : primNaiveSrc };
+            if (!img.defaultBuild(src, 2, "image")) { img.reportBuildLog(); r= -1; continue; }
+            std::cout << (binned ? "binned:" : "naive:") << std::endl;
+            for (int iC=0; iC < nPrimCount; iC++)
+            {
+               const int nP= primCount[iC];
+               MapElement *pR= pRef + iC * n;
+               TimeValF tb=0;
+               bool up;
+
+               if (!binned && (nP > NAIVE_MAX_PRIM)) { tn[iC]= 0; continue; }
+               img.elapsed();
+               if (binned)
+               {
+                  int e= bins.bin(pP, nP, gDef);
+                  tb= img.elapsed();
+                  std::cout << "\t" << nP << " primitives: bin " << tb << "sec, ";
+                  std::cout << (float)e / bins.tiles.nCells() << " per tile, ";
+                  up= primGA.upload(img.ctx, pP, nP, &bins);
+               }
+               else
+               {
+                  std::cout << "\t" << nP << " primitives: ";
+                  up= primGA.upload(img.ctx, pP, nP);
+               }
+               t[0]= img.elapsed();
+               if (!up)
+               {  // device would hold primitives of a previous run
+                  std::cout << "upload failed" << std::endl;
+                  r= -1;
+                  continue;
+               }
+               if (img.execute(lws, primGA, t+1))
+               {
+                  std::cout << "upload " << t[0] << "sec, kernel " << t[2] << "sec";
+                  if (!binned) { tn[iC]= t[2]; memcpy(pR, img.getHost().pI, n * sizeof(*pR)); }
+                  else if (tn[iC] > 0)
+                  {
+                     size_t mis= 0;
+                     for (size_t i=0; i<n; i++) { mis+= (pR[i] != img.getHost().pI[i]); }
+                     std::cout << ", speedup " << tn[iC] / (t[2] + tb) << " (incl. binning), mismatch " << mis << "pix";
+                  }
+                  std::cout << std::endl;
+               }
+               else { r= -1; }
+            }
+         }
+         img.save("img.raw");
+         delete [] pRef;
+         delete [] pP;
+      }
+   }
+   return(r);
+} // main
@@ -0,0 +1,312 @@
+// ocl8.cpp - Euclidean distance transform of raster by jump flooding.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/MapImageOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+
+/* OpenCL kernel sources */
+
+// Seed buffers hold (1D) index of nearest known seed pixel, or -1 for none.
+// Each pass looks at the 3x3 neighbourhood at offset k, where k halves from
+// N/2 to 1 (followed by an extra pass with k=1 to reduce error).
+const char jfaSrc[]=
+"int d2 (const int x, const int y, const int s, const int w) { int dx= x - s % w, dy= y - s / w; return(dx*dx + dy*dy); }\n" \
+"\n" \
+"kernel void jfaInit (__global int *pS, __global const int *pR, const ushort2 def)\n" \
+"{ int x= get_global_id(0), y= get_global_id(1);\n" \
+"  if ((x < def.x) && (y < def.y)) { int i= y * def.x + x; pS[i]= (0 != pR[i]) ? i : -1; } }\n" \
+"\n" \
+"kernel void jfaStep (__global int *pD, __global const int *pS, const ushort2 def, const int k)\n" \
+"{ int x= get_global_id(0), y= get_global_id(1);\n" \
+"  if ((x < def.x) && (y < def.y)) {\n" \
+"    int b= pS[y * def.x + x], bd= (b >= 0) ? d2(x,y,b,def.x) : INT_MAX;\n" \
+"    for (int j=-1; j<=1; j++) { int v= y + j * k; if ((v >= 0) && (v < def.y)) {\n" \
+"      for (int i=-1; i<=1; i++) { int u= x + i * k; if ((u >= 0) && (u < def.x) && (0 != (i|j))) {\n" \
+"        int s= pS[v * def.x + u];\n" \
+"        if (s >= 0) { int d= d2(x,y,s,def.x); if (d < bd) { bd= d; b= s; } } } } } }\n" \
+"    pD[y * def.x + x]= b; } }\n" \
+"\n" \
+"kernel void jfaDist (__global int *pI, const ushort2 def, __global const int *pS)\n" \
+"{ int x= get_global_id(0), y= get_global_id(1);\n" \
+"  if ((x < def.x) && (y < def.y)) { int i= y * def.x + x, s= pS[i];\n" \
+"    pI[i]= (s >= 0) ? convert_int_rte(sqrt((float)d2(x,y,s,def.x))) : -1; } }\n";
+
+
+/***/
+
+// Exact squared Euclidean distance transform (Felzenszwalb & Huttenlocher):
+// lower envelope of parabolas in 1D, applied to columns then rows.
+class CExactEDT
+{
+protected:
+   double   *pF, *pD, *pZ;
+   int      *pV;
+
+   void edt1D (const int n)
+   {
+      int k= 0;
+      pV[0]= 0; pZ[0]= -HUGE_VAL; pZ[1]= HUGE_VAL;
+      for (int q=1; q<n; q++)
+      {
+         double s;
+         do
+         {
+            const int v= pV[k];
+            s= ((pF[q] + q*q) - (pF[v] + v*v)) / (2*q - 2*v);
+         } while ((s <= pZ[k]) && (--k >= 0));
+         ++k;
+         pV[k]= q; pZ[k]= s; pZ[k+1]= HUGE_VAL;
+      }
+      k= 0;
+      for (int q=0; q<n; q++)
+      {
+         while (pZ[k+1] < q) { ++k; }
+         const int v= pV[k];
+         pD[q]= (q - v) * (q - v) + pF[v];
+      }
+   } // edt1D
+
+public:
+   CExactEDT (void) : pF{NULL}, pD{NULL}, pZ{NULL}, pV{NULL} { ; }
+
+   // Squared distance d2[] to nearest non-zero element of raster
+   void transform (double d2[], const CMapImage2D& r)
+   {
+      const int w= r.def.x, h= r.def.y, m= std::max(w,h);
+      pF= new double[m]; pD= new double[m]; pZ= new double[m+1]; pV= new int[m];
+      for (int x=0; x<w; x++)
+      {
+         for (int y=0; y<h; y++) { pF[y]= (0 != r.pI[y * w + x]) ? 0 : 1E20; }
+         edt1D(h);
+         for (int y=0; y<h; y++) { d2[y * w + x]= pD[y]; }
+      }
+      for (int y=0; y<h; y++)
+      {
+         for (int x=0; x<w; x++) { pF[x]= d2[y * w + x]; }
+         edt1D(w);
+         for (int x=0; x<w; x++) { d2[y * w + x]= pD[x]; }
+      }
+      delete [] pF; delete [] pD; delete [] pZ; delete [] pV;
+      pF= pD= pZ= NULL; pV= NULL;
+   } // transform
+}; // CExactEDT
+
+class CJumpFloodOCL : public CMapImageOCL
+{
+protected:
+   cl_kernel   kInit, kStep;  // registered (default idKern is jfaDist)
+   cl_mem      hR, hS[2];     // raster & ping-pong seed buffers
+   int         iS;            // seed buffer holding result
+
+   // Flood from seed buffer iS to the other, which then holds result
+   cl_int pass (const size_t gws[2], const size_t lws[2], cl_int k)
+   {
+      clSetKernelArg(kStep, 0, sizeof(hS[0]), hS+(iS^1));
+      clSetKernelArg(kStep, 1, sizeof(hS[0]), hS+iS);
+      clSetKernelArg(kStep, 2, sizeof(host.def), &(host.def));
+      clSetKernelArg(kStep, 3, sizeof(k), &k);
+      iS^= 1;
+      return clEnqueueNDRangeKernel(q, kStep, 2, NULL, gws, lws, 0, NULL, NULL);
+   } // pass
+
+public:
+   CJumpFloodOCL (void) : kInit{0}, kStep{0}, hR{0}, hS{0,0}, iS{0} { ; }
+   ~CJumpFloodOCL () { release(); }
+
+   bool build (void)
+   {
+      if (defaultBuild(jfaSrc, "jfaDist"))
+      {
+         kInit= kernel("jfaInit");
+         kStep= kernel("jfaStep");
+      }
+      return((0 != kInit) && (0 != kStep));
+   } // build
+
+   // Allocate map and upload raster
+   bool setRaster (const CMapImage2D& raster)
+   {
+      cl_int r[3];
+      if (createArgs(raster.def.x, raster.def.y))
+      {
+         hR= clCreateBuffer(ctx, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, device.bytes, raster.pI, r+0);
+         hS[0]= clCreateBuffer(ctx, CL_MEM_READ_WRITE|CL_MEM_HOST_READ_ONLY, device.bytes, NULL, r+1);
+         hS[1]= clCreateBuffer(ctx, CL_MEM_READ_WRITE|CL_MEM_HOST_READ_ONLY, device.bytes, NULL, r+2);
+         return((r[0] >= 0) && (r[1] >= 0) && (r[2] >= 0));
+      }
+      return(false);
+   } // setRaster
+
+   // Run init, flooding passes and distance computation: returns number of
+   // flooding passes, timings [init, passes, distance, readback]
+   int transform (size_t lws[2], TimeValF *pDT=NULL)
+   {
+      size_t gws[2];
+      cl_int r;
+      int n= 0;
+
+      host.setGWS(gws, lws);
+      elapsed();
+      clSetKernelArg(kInit, 0, sizeof(hS[0]), hS+0);
+      clSetKernelArg(kInit, 1, sizeof(hR), &hR);
+      clSetKernelArg(kInit, 2, sizeof(host.def), &(host.def));
+      r= clEnqueueNDRangeKernel(q, kInit, 2, NULL, gws, lws, 0, NULL, NULL);
+      clFinish(q);
+      if (pDT) { pDT[0]= elapsed(); }
+
+      iS= 0;
+      int k= 1;
+      while ((2 * k) < std::max(host.def.x, host.def.y)) { k*= 2; }
+      for ( ; (r >= 0) && (k > 0); k/= 2) { r= pass(gws, lws, k); ++n; }
+      if (r >= 0) { r= pass(gws, lws, 1); ++n; } // extra pass (JFA+1)
+      clFinish(q);
+      if (pDT) { pDT[1]= elapsed(); }
+
+      clSetKernelArg(idKern, 0, sizeof(device.hI), &(device.hI));
+      clSetKernelArg(idKern, 1, sizeof(host.def), &(host.def));
+      clSetKernelArg(idKern, 2, sizeof(hS[0]), hS+iS);
+      if (r >= 0) { r= clEnqueueNDRangeKernel(q, idKern, 2, NULL, gws, lws, 0, NULL, NULL); }
+      clFinish(q);
+      if (pDT) { pDT[2]= elapsed(); }
+
+      if (r >= 0) { r= clEnqueueReadBuffer(q, device.hI, CL_BLOCKING, 0, device.bytes, host.pI, 0, NULL, NULL); }
+      if (pDT) { pDT[3]= elapsed(); }
+      return((r >= 0) ? n : -1);
+   } // transform
+
+   // Nearest seed index per element (for error analysis)
+   bool readSeeds (int s[])
+   {
+      return(clEnqueueReadBuffer(q, hS[iS], CL_BLOCKING, 0, device.bytes, s, 0, NULL, NULL) >= 0);
+   } // readSeeds
+
+   bool release (bool all=true)
+   {
+      kInit= kStep= 0; // released with program
+      for (int i=0; i<2; i++) { if (0 != hS[i]) { clReleaseMemObject(hS[i]); hS[i]= 0; } }
+      if (0 != hR) { clReleaseMemObject(hR); hR= 0; }
+      return CMapImageOCL::release(all);
+   } // release
+}; // CJumpFloodOCL
+
+float frand (float a, float b) { return(a + (b - a) * rand() / (float)RAND_MAX); }
+
+// Synthetic occupancy: scattered discs and isolated points
+void genRaster (CMapImage2D& r, Def1D w, Def1D h)
+{
+   r.allocate(w,h);
+   for (size_t i=0; i<r.numElem(); i++) { r.pI[i]= 0; }
+   for (int k=0; k<64; k++)
+   {
+      const int cx= frand(0,w), cy= frand(0,h), rad= frand(0,8);
+      for (int y= std::max(0,cy-rad); y <= std::min(h-1,cy+rad); y++)
+      {
+         for (int x= std::max(0,cx-rad); x <= std::min(w-1,cx+rad); x++)
+         {
+            if (((x-cx)*(x-cx) + (y-cy)*(y-cy)) <= (rad*rad)) { r.pI[y * w + x]= 1; }
+         }
+      }
+   }
+} // genRaster
+
+
+/***/
+
+CJumpFloodOCL jfa; // global to avoid segment violation
+CMapImage2D raster;
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (argc > 3) // <file.raw> <width> <height> : 8bit grey, non-zero -> occupied
+   {
+      if (0 == raster.load(argv[1], atoi(argv[2]), atoi(argv[3])))
+      {
+         std::cout << "failed to load " << argv[1] << std::endl;
+         return(r);
+      }
+   }
+   else { srand(1); genRaster(raster, 512, 512); }
+
+   if (nDev > 0)
+   {
+      TimeValF t[6];
+      size_t lws[2]={16,16};
+
+      if (jfa.create(idDev[0]) && jfa.setRaster(raster))
+      {
+         t[0]= jfa.elapsed();
+         std::cout << "context created: " << t[0] << "sec" << std::endl;
+         if (jfa.build())
+         {
+            t[1]= jfa.elapsed();
+            std::cout << "build OK: " << t[1] << "sec" << std::endl;
+
+            const int nP= jfa.transform(lws, t+2);
+            if (nP > 0)
+            {
+               const size_t n= raster.numElem();
+               const int w= raster.def.x;
+               double *pE= new double[n];
+               int *pS= new int[n];
+               CExactEDT edt;
+               TimeValF tH;
+
+               std::cout << "jump flood: " << nP << " passes" << std::endl;
+               std::cout << "\tinit:       " << t[2] << "sec" << std::endl;
+               std::cout << "\tpasses:     " << t[3] << "sec" << std::endl;
+               std::cout << "\tdistance:   " << t[4] << "sec" << std::endl;
+               std::cout << "\tbuffer-out: " << t[5] << "sec" << std::endl;
+
+               jfa.elapsed();
+               edt.transform(pE, raster);
+               tH= jfa.elapsed();
+               std::cout << "exact host: " << tH << "sec (speedup " << tH / (t[2]+t[3]+t[4]) << ")" << std::endl;
+
+               if (jfa.readSeeds(pS))
+               {
+                  size_t mis= 0, nC= 0; // nC: pixels compared (seeded)
+                  double maxE= 0, sumE= 0;
+                  for (size_t i=0; i<n; i++)
+                  {
+                     if (pS[i] >= 0)
+                     {
+                        nC++;
+                        const int x= i % w, y= i / w, sx= pS[i] % w, sy= pS[i] / w;
+                        const double e= sqrt((x-sx)*(x-sx) + (y-sy)*(y-sy)) - sqrt(pE[i]);
+                        if (e > 1E-6) { mis++; sumE+= e; if (e > maxE) { maxE= e; } }
+                     }
+                     else if (pE[i] < 1E20) { mis++; }
+                  }
+                  std::cout << "error: mismatch=" << mis << "pix (" << 100.0 * mis / n << "%) max=" << maxE;
+                  std::cout << " mean=" << (nC ? sumE / nC : 0) << std::endl;
+                  r= 0;
+               }
+               delete [] pS;
+               delete [] pE;
+               jfa.save("img.raw");
+            }
+         }
+         else { jfa.reportBuildLog(); }
+      }
+   }
+   return(r);
+} // main
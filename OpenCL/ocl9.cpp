@@ -0,0 +1,94 @@
+// ocl9.cpp - Stencil (neighbourhood) post processing of map images on device.
+// https://github.com/DrAl-HFS/Compute.git
+// Licence: AGPL3
+// (c) Project Contributors May-July 2021
+
+#include <iostream>
+
+#include "Common/SimpleOCL.hpp"
+#include "Common/QueryOCL.hpp"
+#include "Common/StencilOCL.hpp"
+#include "Common/KernSrcOCL.hpp"
+#include "Common/MapGeomOCL.hpp"
+
+/***/
+
+// Query parameters
+#define MAX_PF_ID    2
+#define MAX_DEV_ID   4
+
+
+/***/
+Def2D gDef={512,512};
+
+// Mandelbrot (ocl3) as source map
+const MandelGeomArgs mandelGA(Complex2D(-0.909, -0.275), Complex2D(0.3,0.3));
+
+// Radius sweep of single stage, then a chain
+const int blurRad[]= { 1, 2, 4, 8 };
+const StencilStage chain[]= { { &stBlur, 2, BM_MIRROR }, { &stGradient, 1, BM_CLAMP }, { &stDilate, 2, BM_ZERO } };
+const int nChain= sizeof(chain) / sizeof(chain[0]);
+
+CStencilMapOCL img; // global to avoid segment violation
+
+// Run stencil chain both ways, report timing & discrepancy, return tiled/naive time ratio
+float compareChain (const StencilStage s[], const int n, size_t lws[2], MapElement *pRef)
+{
+   TimeValF t[2][STENCIL_STAGE_MAX], tt[2]={0,0};
+   const size_t nE= img.getHost().numElem();
+   size_t mis= 0;
+
+   if (!img.buildChain(s, n, lws)) { img.reportChainLog(); return(0); }
+   for (int tiled=0; tiled<2; tiled++)
+   {
+      img.applyChain(tiled, t[tiled]);
+      for (int i=0; i<n; i++) { tt[tiled]+= t[tiled][i]; }
+      img.readChain();
+      if (0 == tiled) { memcpy(pRef, img.getHost().pI, nE * sizeof(*pRef)); }
+      else { for (size_t i=0; i<nE; i++) { mis+= (pRef[i] != img.getHost().pI[i]); } }
+   }
+   for (int i=0; i<n; i++)
+   {
+      std::cout << "\t" << s[i].pOp->name << " r=" << s[i].r << ": naive " << t[0][i] << "sec, tiled " << t[1][i] << "sec" << std::endl;
+   }
+   std::cout << "\ttotal: naive " << tt[0] << "sec, tiled " << tt[1] << "sec, speedup " << tt[0] / tt[1] << ", mismatch " << mis << "pix" << std::endl;
+   return(tt[1] / tt[0]);
+} // compareChain
+
+int main (int argc, char *argv[])
+{
+   cl_platform_id idPfm[MAX_PF_ID]={0,};
+   cl_device_id   idDev[MAX_DEV_ID]={0,};
+   cl_uint        nDev= queryDevPfm(idDev, MAX_DEV_ID, idPfm, MAX_PF_ID);
+   int r=-1;
+
+   if (nDev > 0)
+   {
+      TimeValF t[5];
+      size_t lws[2]={32,32}, sws[2]={16,16};
+
+      if (img.create(idDev[0]) && img.createArgs(gDef.x,gDef.y))
+      {
+         t[0]= img.elapsed();
+         std::cout << "context created: " << t[0] << "sec" << std::endl;
+
+         if (img.defaultBuild(mandelKernSrc, "image") && img.execute(lws, mandelGA, t+1))
+         {
+            MapElement *pRef= new MapElement[img.getHost().numElem()];
+            std::cout << "source map: " << t[2] << "sec" << std::endl;
+            r= 0;
+            for (int i=0; i < (int)(sizeof(blurRad)/sizeof(blurRad[0])); i++)
+            {
+               StencilStage s= { &stBlur, blurRad[i], BM_CLAMP };
+               std::cout << "single stage:" << std::endl;
+               if (compareChain(&s, 1, sws, pRef) <= 0) { r= -1; }
+            }
+            std::cout << "chain:" << std::endl;
+            if (compareChain(chain, nChain, sws, pRef) > 0) { img.save("img.raw"); } else { r= -1; }
+            delete [] pRef;
+         }
+         else { img.reportBuildLog(); }
+      }
+   }
+   return(r);
+} // main